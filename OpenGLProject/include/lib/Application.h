@@ -14,7 +14,11 @@
 
 #include <lib/Shader.h>
 #include <lib/Camera.h>
+#include <lib/GeometryRegistry.h>
+#include <lib/HotReloader.h>
 #include <lib/Model.h>
+#include <lib/ModelStreamer.h>
+#include <lib/VirtualTextureCache.h>
 
 //Same lighting structs as in shaders except for constructors
 
@@ -64,6 +68,10 @@ struct ProgramState {
     glm::vec3 planeColor = glm::vec3(0);
     glm::vec3 clearColor = glm::vec3(0);
     glm::vec3 lightColor = glm::vec3(0);
+    // not saved: whether the model culls its meshlets, the triangles it was drawn with last frame and its memory
+    bool meshletCulling = true;
+    size_t modelTriangles = 0;
+    Model::MemoryStats modelMemory = { 0, 0 };
     DirLight dirLight;
     PointLight pointLight;
     ProgramState()
@@ -92,6 +100,16 @@ void DrawImGui(ProgramState* programState);
 const unsigned int SCR_WIDTH = 1024;
 const unsigned int SCR_HEIGHT = 720;
 
+//Time per frame that may be spent uploading streamed models to the GPU
+
+const double STREAMING_BUDGET = 0.004;
+
+//GPU memory that holds the pages of virtual textures, and how many of them may be loaded per frame. 64 tiles, far
+//less than the 17.5 MB mars.png takes with its mip chain, so coming closer evicts the pages that went out of view
+
+const size_t VIRTUAL_TEXTURE_BUDGET = 4 * 1024 * 1024;
+const size_t VIRTUAL_PAGES_PER_FRAME = 8;
+
 //Camera movement variables
 
 float lastX = SCR_WIDTH / 2.0f;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <lib/CompressedTexture.h>
+#include <lib/ThreadPool.h>
+
+// CPU encoder/decoder for the block compressed formats the asset cooker produces:
+//  BC1 (GL_COMPRESSED_RGBA_S3TC_DXT1_EXT)  opaque color, 4 bits per pixel
+//  BC4 (GL_COMPRESSED_RED_RGTC1)           one channel taken from red, 4 bits per pixel
+//  BC5 (GL_COMPRESSED_RG_RGTC2)            two channels taken from red and green, 8 bits per pixel
+//  BC7 (GL_COMPRESSED_RGBA_BPTC_UNORM)     color with alpha, mode 6 only, 8 bits per pixel
+// Pixel input and output is always RGBA8.
+
+bool CanCompressFormat(GLenum format);
+
+// number of leading RGBA channels the format keeps (1 for BC4 ... 4 for BC7)
+int CompressedChannelCount(GLenum format);
+
+// encodes width x height RGBA8 pixels into CompressedLevelBytes(format, width, height) bytes of output.
+// Rows of blocks are spread over the pool; partial edge blocks repeat the last row/column.
+void CompressImage(GLenum format, const unsigned char* rgba, int width, int height, unsigned char* output, ThreadPool& pool);
+
+// decodes data produced by CompressImage back to RGBA8, e.g. to measure the encoding error.
+// Returns false for blocks the decoder doesn't handle (BC7 modes other than 6).
+bool DecompressImage(GLenum format, const unsigned char* data, int width, int height, unsigned char* rgba);
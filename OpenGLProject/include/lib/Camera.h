@@ -37,6 +37,9 @@ public:
     Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH);
 
     glm::mat4 GetViewMatrix();
+    // how many pixels one world space unit at point covers in a viewport viewportHeight pixels tall, for the
+    // perspective projection with a vertical field of view of Zoom degrees
+    float PixelsPerUnit(const glm::vec3& point, float viewportHeight) const;
     void ProcessKeyboard(Camera_Movement direction, float deltaTime);
     void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true); 
     void ProcessMouseScroll(float yoffset);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Block compressed formats that aren't part of the GL 3.3 core profile glad was generated for.
+// They come from EXT_texture_compression_s3tc, EXT_texture_sRGB and ARB_texture_compression_bptc.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+struct CompressedMipLevel {
+    int width;
+    int height;
+    size_t offset;
+    size_t size;
+};
+
+// A BCn texture with its whole mip chain, as stored in a DDS or KTX file.
+struct CompressedImage {
+    GLenum format = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<CompressedMipLevel> levels;
+    std::vector<unsigned char> data;
+};
+
+// bytes per 4x4 block, 0 for formats we don't handle
+size_t CompressedBlockBytes(GLenum format);
+size_t CompressedLevelBytes(GLenum format, int width, int height);
+
+// reads a DDS (legacy FourCC or DX10 header) or KTX 1 file holding BC1/BC3/BC4/BC5/BC7 data
+bool ReadCompressedTexture(const std::string& path, CompressedImage& image);
+bool IsCompressedTexturePath(const std::string& path);
+
+// writes the image and its levels as a DDS file with a DX10 header, which ReadCompressedTexture reads back
+bool WriteDDS(const std::string& path, const CompressedImage& image);
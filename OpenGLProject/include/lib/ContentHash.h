@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// 128 bit non-cryptographic hash of file or memory contents, for telling whether derived data is stale when
+// modification times can't be trusted (copied or deployed files). Not stable across endianness.
+struct ContentHash {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const ContentHash& other) const;
+    bool operator!=(const ContentHash& other) const;
+
+    // 32 lower case hex digits, high half first
+    std::string ToHex() const;
+    static bool FromHex(const std::string& text, ContentHash& hash);
+};
+
+// the halves are already well mixed, either one makes a good bucket index
+namespace std {
+    template <>
+    struct hash<ContentHash> {
+        size_t operator()(const ContentHash& hash) const {
+            return (size_t)hash.low;
+        }
+    };
+}
+
+// seed chains hashes: HashBytes(b, size, HashBytes(a, size)) covers a and then b
+ContentHash HashBytes(const void* data, size_t size, ContentHash seed = ContentHash());
+ContentHash HashString(const std::string& text, ContentHash seed = ContentHash());
+
+// hashes the mapped file; an empty file hashes like no bytes. Returns false if it can't be read.
+bool HashFile(const std::string& path, ContentHash& hash, ContentHash seed = ContentHash());
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Modification time and size of a file on disk, used to tell whether derived data is stale.
+struct FileStamp {
+    long long modifiedTime;
+    unsigned long long size;
+};
+
+bool GetFileStamp(const std::string& path, FileStamp& stamp);
+
+// a name next to path for writing a file that is then renamed to path, unique per call and process, so writers of the
+// same file on different threads or in the cooker never write into one temporary file
+std::string TempPathFor(const std::string& path);
+
+// appends the paths of all regular files below directory (recursively, '/' separated) to files.
+// Returns false if directory can't be opened.
+bool ListFiles(const std::string& directory, std::vector<std::string>& files);
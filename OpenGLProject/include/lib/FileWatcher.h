@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <lib/FileUtils.h>
+
+// Reports changes to a set of files from a background thread. On Linux it listens to inotify on the files'
+// directories, so files an editor replaces through a rename are caught as well; elsewhere it compares their
+// modification time and size a few times a second. Paths are canonical (TextureRegistry::CanonicalPath).
+class FileWatcher {
+public:
+
+    // a file only counts as changed once it was left alone for settleSeconds, so a save written in several
+    // steps is reported once, after the last one
+    explicit FileWatcher(double settleSeconds = 0.1);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // starts watching the file, watching it again does nothing. Returns false if it can't be watched.
+    bool Watch(const std::string& path);
+
+    // canonical paths of the watched files that changed and settled since the last call
+    std::vector<std::string> TakeChanges();
+
+private:
+
+    double m_settleSeconds;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+
+    // everything below is shared with the watch thread
+    std::mutex m_mutex;
+    std::unordered_set<std::string> m_files;
+    // watched file -> time of its last change event
+    std::unordered_map<std::string, double> m_pending;
+#ifdef __linux__
+    int m_inotify;
+    // watch descriptor -> directory, and the reverse
+    std::unordered_map<int, std::string> m_directories;
+    std::unordered_map<std::string, int> m_watches;
+#else
+    std::unordered_map<std::string, FileStamp> m_stamps;
+#endif
+
+    void run();
+    void changed(const std::string& path);
+
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <lib/ContentHash.h>
+#include <lib/Mesh.h>
+
+// Process wide store of mesh GPU buffers, keyed by the content hash of the geometry they were uploaded from
+// (see HashGeometry), so byte identical meshes share one vertex array and its buffers even when they come
+// from differently named copies of a model. Entries are reference counted; the GL objects are deleted with
+// the last reference. GL thread only.
+class GeometryRegistry {
+public:
+
+    // the GL objects and what Mesh::setupMesh decided while filling them, which every mesh drawing them needs
+    struct Buffers {
+        unsigned int VAO, VBO, EBO;
+        size_t vertexBufferBytes, indexBufferBytes;
+        GLenum indexType;
+        vector<vector<IndexRange>> indexRanges;
+        glm::vec3 positionOffset;
+        glm::vec3 positionScale;
+    };
+
+    struct Stats {
+        size_t hits;           // meshes served by buffers already uploaded for the same content
+        size_t misses;         // meshes that had to upload their own buffers
+        size_t geometries;     // live vertex arrays
+        size_t residentBytes;  // GPU memory of all live vertex and index buffers
+        size_t reusedBytes;    // GPU memory that hits didn't have to allocate again
+    };
+
+    static GeometryRegistry& Instance();
+
+    // takes a reference on the buffers uploaded for hash and returns them, null if there are none yet
+    const Buffers* Acquire(const ContentHash& hash);
+    // registers buffers just uploaded for hash, holding one reference
+    void Add(const ContentHash& hash, const Buffers& buffers);
+    // drops a reference on the buffers drawn with vao, ids the registry doesn't know are ignored
+    void Release(unsigned int vao);
+
+    Stats GetStats() const;
+
+private:
+
+    struct Entry {
+        ContentHash hash;
+        unsigned int refCount;
+        Buffers buffers;
+    };
+
+    std::unordered_map<ContentHash, unsigned int> m_vaosByHash;
+    std::unordered_map<unsigned int, Entry> m_entries;
+    Stats m_stats;
+
+    GeometryRegistry();
+
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <lib/FileWatcher.h>
+#include <lib/Model.h>
+#include <lib/ModelStreamer.h>
+
+// Reloads the models and textures whose files change on disk while the application runs. A changed model file or
+// material library is imported again, past the mesh cache, and streamed into a second Model; a changed texture is
+// decoded on the shared pool without its cooked version, which predates the edit, a paged one by the
+// VirtualTextureCache. The old GPU resources stay in use until the new ones are completely uploaded, then Update swaps
+// them in between two frames. GL thread only.
+class HotReloader {
+public:
+
+    // watches the model's files, and once it's loaded the textures it uses. Doesn't keep the model alive.
+    void Track(const std::shared_ptr<Model>& model, const string& path);
+
+    // call once per frame on the GL thread, before anything is drawn
+    void Update(double budgetSeconds);
+
+private:
+
+    struct TrackedModel {
+        std::weak_ptr<Model> model;
+        string path;
+        // canonical paths of the files the model is built from
+        std::unordered_set<string> dependencies;
+        // whether the files of the model's current contents are watched
+        bool watching;
+        // the reload being streamed in, swapped into model once it's ready
+        std::shared_ptr<Model> replacement;
+    };
+
+    struct TextureReload;
+
+    FileWatcher m_watcher;
+    ModelStreamer m_streamer;
+    vector<TrackedModel> m_models;
+    vector<std::shared_ptr<TextureReload>> m_textures;
+
+    void watchFiles(TrackedModel& tracked, const Model& model);
+    void reloadTexture(const string& path);
+
+};
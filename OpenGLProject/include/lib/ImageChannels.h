@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+// swizzle sources besides the stored channels 0-3
+const unsigned char CHANNEL_ZERO = 4;
+const unsigned char CHANNEL_ONE = 5;
+
+// Which channels of an RGBA8 image have to be stored on the GPU, and how sampling rebuilds the others: a grey
+// image stores one channel and reads it back as r, g and b, an opaque one drops its alpha and reads 1 instead.
+struct ChannelLayout {
+    // stored channels, 1 to 4
+    int count = 4;
+    // source channel of every stored channel, in order
+    unsigned char sources[4] = { 0, 1, 2, 3 };
+    // what sampling returns for r, g, b and a: a stored channel, CHANNEL_ZERO or CHANNEL_ONE
+    unsigned char swizzle[4] = { 0, 1, 2, 3 };
+
+    bool operator==(const ChannelLayout& other) const;
+    bool operator!=(const ChannelLayout& other) const { return !(*this == other); }
+};
+
+// finds the channels of pixelCount RGBA8 pixels that are constantly 0 or 255, or equal to another channel, and
+// returns the narrowest layout that still samples the same. The mip filters work on every channel alike, so the
+// result for level 0 holds for the whole chain.
+ChannelLayout AnalyzeChannels(const unsigned char* rgba, size_t pixelCount);
+
+// copies the stored channels of pixelCount RGBA8 pixels to out, layout.count bytes per pixel
+void PackChannels(const unsigned char* rgba, size_t pixelCount, const ChannelLayout& layout, unsigned char* out);
+
+// the reverse for CPU readers: rebuilds pixelCount RGBA8 pixels from packed ones the way sampling does
+void ExpandChannels(const unsigned char* packed, size_t pixelCount, const ChannelLayout& layout, unsigned char* rgba);
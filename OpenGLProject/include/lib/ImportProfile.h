@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+// Named sets of assimp post-processing steps a model can be imported with. The flags are part of the mesh cache key,
+// so every profile keeps its own cache entry. ImportBenchmark times each step of a profile on a given asset.
+enum ImportProfile {
+    // triangles, flipped uvs and flat normals where the file has none: quickest to load, faceted where normals are missing
+    IMPORT_PROFILE_FAST_PREVIEW,
+    // what the model shaders read: smooth normals where the file has none, no tangent frame
+    IMPORT_PROFILE_RUNTIME,
+    // validated data with tangents and bitangents, for shaders that do normal mapping
+    IMPORT_PROFILE_FULL_QUALITY,
+    IMPORT_PROFILE_COUNT
+};
+
+// the same steps for every shader a model is loaded for, so the runtime reads the mesh caches AssetCooker writes
+unsigned int ImportFlagsFor(ImportProfile profile);
+
+// "fast-preview", "runtime" or "full-quality"
+const char* ImportProfileName(ImportProfile profile);
+bool ParseImportProfile(const std::string& name, ImportProfile& profile);
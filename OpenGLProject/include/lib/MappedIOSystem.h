@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <lib/MappedFile.h>
+
+// Read-only Assimp stream over a memory-mapped file.
+class MappedIOStream : public Assimp::IOStream {
+public:
+
+    MappedIOStream();
+
+    bool Open(const std::string& path);
+
+    size_t Read(void* buffer, size_t size, size_t count) override;
+    // always fails, the mapping is read-only
+    size_t Write(const void* buffer, size_t size, size_t count) override;
+    aiReturn Seek(size_t offset, aiOrigin origin) override;
+    size_t Tell() const override;
+    size_t FileSize() const override;
+    void Flush() override;
+
+    // the whole file, for callers that can parse it in place instead of reading it
+    const unsigned char* Data() const;
+
+private:
+
+    MappedFile m_file;
+    size_t m_position;
+
+};
+
+// Assimp file system that maps the files it opens instead of reading them through stdio, so a model and the files
+// it references (material libraries, external buffers) are parsed from the page cache without a second copy in
+// stdio buffers. Opening for writing fails. Apart from the list of opened paths it keeps no state between files, so
+// any Importer, or any other loader that wants Assimp style file access, can use one; note that
+// Importer::SetIOHandler takes ownership.
+class MappedIOSystem : public Assimp::IOSystem {
+public:
+
+    using Assimp::IOSystem::Exists;
+    using Assimp::IOSystem::Open;
+
+    bool Exists(const char* path) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(const char* path, const char* mode = "rb") override;
+    void Close(Assimp::IOStream* stream) override;
+
+    // every file opened so far, once each in the order of their first open: the model and everything it pulled in
+    const std::vector<std::string>& OpenedPaths() const;
+
+private:
+
+    std::vector<std::string> m_openedPaths;
+
+};
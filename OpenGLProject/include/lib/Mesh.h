@@ -5,8 +5,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <lib/ContentHash.h>
 #include <lib/Shader.h>
 
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
@@ -21,29 +23,252 @@ struct Vertex {
 
 
 
+// GPU side vertex layouts, picked per mesh at import by ChooseVertexFormat. The CPU copy is always a Vertex.
+// The sizes are those of a vertex with every stream, see VertexStreams.
+enum VertexFormat {
+    // Vertex as is, 56 bytes
+    VERTEX_FORMAT_FLOAT,
+    // PackedVertex, 24 bytes
+    VERTEX_FORMAT_PACKED,
+    // QuantizedVertex, 20 bytes
+    VERTEX_FORMAT_QUANTIZED
+};
+
+// Attributes a mesh's vertex buffer holds, one bit per attribute location. Streams the shaders drawing the mesh don't
+// read are left out of the buffer, e.g. position, normal and texture coordinates take 32 of the float format's 56 bytes.
+// The packed formats have no bitangent stream, it's rebuilt from the tangent's handedness.
+enum VertexStream {
+    VERTEX_STREAM_POSITION = 1 << 0,
+    VERTEX_STREAM_NORMAL = 1 << 1,
+    VERTEX_STREAM_TEXCOORDS = 1 << 2,
+    VERTEX_STREAM_TANGENT = 1 << 3,
+    VERTEX_STREAM_BITANGENT = 1 << 4
+};
+typedef unsigned int VertexStreams;
+const int VERTEX_STREAM_COUNT = 5;
+const VertexStreams VERTEX_STREAMS_ALL = (1 << VERTEX_STREAM_COUNT) - 1;
+
+// the streams at the locations of the program's active attributes; the position is always kept
+VertexStreams VertexStreamsFor(const Shader& shader);
+
+// Compact vertex: octahedral encoded normal and tangent, half float texture coordinates. The bitangent is
+// dropped, it's cross(normal, tangent) times the handedness stored with the tangent.
+struct PackedVertex {
+    float    Position[3];
+    int16_t  Normal[2];    // octahedral, snorm16
+    uint16_t TexCoords[2]; // half float
+    int8_t   Tangent[4];   // octahedral xy and handedness z, snorm8
+};
+
+// PackedVertex with positions stored as snorm16 within the mesh bounds, the shader dequantizes them
+// with the mesh's positionOffset and positionScale.
+struct QuantizedVertex {
+    int16_t  Position[4];  // snorm16 xyz, w unused
+    int16_t  Normal[2];
+    uint16_t TexCoords[2];
+    int8_t   Tangent[4];
+};
+
+// the most compact format that keeps the mesh's texture coordinates and positions accurate
+VertexFormat ChooseVertexFormat(const Vertex* vertices, size_t vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+// Contiguous run of a mesh's indices drawn with one call. baseVertex is added to every index, which lets
+// meshes with more than 65536 vertices keep 16 bit indices as long as each range spans fewer vertices.
+struct IndexRange {
+    size_t firstIndex;
+    size_t indexCount;
+    int    baseVertex;
+};
+
+// picks GL_UNSIGNED_SHORT when the triangle list can be drawn with 16 bit indices, splitting it into ranges
+// if needed, and GL_UNSIGNED_INT (one range) when the split would take too many draw calls
+GLenum ChooseIndexType(const unsigned int* indices, size_t indexCount, size_t vertexCount, vector<IndexRange>& ranges);
+
+// What a Mesh keeps on the CPU once its buffers are uploaded, see Mesh::SetResidency. Textures and the draw
+// metadata (levels of detail, meshlets) are always kept since drawing needs them.
+enum MeshResidency {
+    // vertices and indices as imported
+    MESH_RESIDENCY_KEEP,
+    // positions and indices only, e.g. for picking and physics
+    MESH_RESIDENCY_POSITIONS,
+    // no geometry at all
+    MESH_RESIDENCY_DISCARD
+};
+
+// One level of detail: a slice of the mesh's indices drawn with the shared vertices. error is the area weighted root
+// mean square distance (in object space units) of the simplified surface from the full one's planes, the full mesh
+// being level 0 with an error of 0. Single vertices may stray further than that.
+struct MeshLod {
+    size_t firstIndex;
+    size_t indexCount;
+    float  error;
+};
+
+// Cluster of a mesh's full level of detail, see BuildMeshlets. The CPU culls it against the frustum with its bounding
+// sphere, and as back facing with the cone holding its triangle normals: no triangle faces a viewer v for which
+// dot(center - v, coneAxis) >= coneCutoff * length(center - v) + radius.
+struct Meshlet {
+    size_t firstIndex;
+    size_t indexCount;
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// A material texture: layer of the texture array id, see TextureRegistry, or for a virtual texture the id of its
+// page table, see VirtualTextureCache. Meshes draw id 0, a texture not loaded (yet), with a grey placeholder.
 struct Texture {
     unsigned int id;
     string type;
     string path;
+    unsigned int layer = 0;
+    bool isVirtual = false;
+};
+
+// Non-owning view of a mesh's geometry, pointing into a MeshData or a memory-mapped mesh cache.
+struct MeshView {
+    const Vertex*       vertices;
+    size_t              vertexCount;
+    const unsigned int* indices;
+    size_t              indexCount;
+    vector<Texture>     textures;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    VertexFormat vertexFormat;
+    vector<MeshLod> lods;
+    vector<Meshlet> meshlets;
+    // identifies the GPU buffers, see HashGeometry
+    ContentHash geometryHash;
+};
+
+// CPU-side result of importing a single mesh, before anything is uploaded to the GPU.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    VertexFormat vertexFormat;
+    // every level's indices follow each other in indices, see BuildMeshLods
+    vector<MeshLod> lods;
+    // clusters of the full level, empty if the mesh is too small to be worth culling in parts
+    vector<Meshlet> meshlets;
+    ContentHash geometryHash;
+
+    MeshView View() const {
+        MeshView view = { vertices.data(), vertices.size(), indices.data(), indices.size(), textures, boundsMin, boundsMax, vertexFormat, lods, meshlets, geometryHash };
+        return view;
+    }
 };
 
+// hash of everything that goes into a mesh's GPU buffers: vertices, indices, vertex format and the levels of
+// detail (they decide the index ranges). Meshes with equal hashes share their buffers, see GeometryRegistry.
+ContentHash HashGeometry(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+    VertexFormat vertexFormat, const vector<MeshLod>& lods);
+
 class Mesh {
 public:
 
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // vertex positions once vertices were released under MESH_RESIDENCY_POSITIONS, empty otherwise
+    vector<glm::vec3>    positions;
 
     unsigned int VAO;
     std::string glslIdentifierPrefix;
 
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures);
+    // object space axis aligned bounding box
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    // layout of the vertex buffer and the attributes it holds, and the transform from its positions to object space
+    VertexFormat vertexFormat;
+    VertexStreams vertexStreams;
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+
+    // levels of detail within indices, the full mesh first
+    vector<MeshLod> lods;
+    vector<Meshlet> meshlets;
 
-    void Draw(Shader& shader);
+    // width of the GPU index buffer and the draw calls covering each level; the CPU copy is always 32 bit
+    GLenum indexType;
+    vector<vector<IndexRange>> indexRanges;
+
+    // picks the vertex format itself and has a single level of detail
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexStreams streams = VERTEX_STREAMS_ALL);
+    // uploads the streams straight from the viewed arrays (e.g. a memory-mapped cache file) and keeps a CPU copy;
+    // bounds, vertex format and geometry hash are taken as given. Nothing is uploaded if a mesh with the same hash and
+    // streams already was, its buffers are shared instead.
+    explicit Mesh(const MeshView& view, VertexStreams streams = VERTEX_STREAMS_ALL);
+    // same, but takes over the imported arrays as its CPU copy instead of copying them
+    explicit Mesh(MeshData&& data, VertexStreams streams = VERTEX_STREAMS_ALL);
+    // drops its reference on the GL objects, needs the GL context to still be alive
+    ~Mesh();
+
+    // holds a reference on its GL objects, so it can only be moved
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+
+    void Draw(Shader& shader, size_t lod = 0);
+    // draws the full level without the meshlets IsMeshletVisible rejects, falls back to Draw without meshlets.
+    // viewer and planes are in object space. Returns the number of triangles drawn.
+    size_t DrawVisibleMeshlets(Shader& shader, const glm::vec3& viewer, const glm::vec4 planes[6]);
+
+    // coarsest level whose RMS error covers at most maxPixelError pixels at pixelsPerUnit object space units
+    size_t SelectLod(float pixelsPerUnit, float maxPixelError) const;
+
+    // releases the CPU geometry the policy doesn't keep; it only comes back by importing again
+    void SetResidency(MeshResidency residency);
+    // memory held by the CPU side arrays (geometry and draw metadata) and by the GL buffers, which other meshes
+    // with the same geometry may share
+    size_t CpuBytes() const;
+    size_t GpuBytes() const;
+
+    // forgets which texture arrays the material units hold, call before drawing meshes after anything else bound
+    // textures
+    static void ResetBoundTextures();
+    // sampler uniform textures[i] is bound to: the prefix, its type and its number among the textures of that type
+    static string SamplerName(const vector<Texture>& textures, size_t i, const string& prefix);
 
 private:
 
     unsigned int VBO, EBO;
+    size_t vertexBufferBytes, indexBufferBytes;
+
+    // glMultiDrawElementsBaseVertex arguments, kept between frames
+    vector<GLsizei> drawCounts;
+    vector<const void*> drawOffsets;
+    vector<GLint> drawBaseVertices;
+
+    // what bindMaterial looked up in a program under a name prefix: per texture the unit it's bound to (-1 if none)
+    // and the location of its layer uniform, and the uniforms texture_diffuse1 reads when it's a virtual texture
+    struct MaterialProgram {
+        unsigned int program;
+        string prefix;
+        vector<GLint> units;
+        vector<GLint> layerLocations;
+        // index of texture_diffuse1 in textures, -1 if the mesh has no diffuse map
+        int diffuse;
+        GLint virtualLocation;
+        GLint virtualSizeLocation;
+        GLint virtualIndexLocation;
+    };
+    // usually the shading and the feedback program
+    vector<MaterialProgram> materialPrograms;
+
+    MaterialProgram& materialProgram(Shader& shader);
+
+    void bindMaterial(Shader& shader);
+    void release();
 
-    void setupMesh();
+    // takes the buffers already uploaded for geometryHash, or converts the vertices and indices straight into
+    // mapped GL buffers, without an intermediate copy, and registers them
+    void setupMesh(const Vertex* vertexData, const unsigned int* indexData, const ContentHash& geometryHash);
+    void uploadBuffers(const Vertex* vertexData, const unsigned int* indexData);
+    void computeBounds();
 };
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <lib/ContentHash.h>
+#include <lib/Mesh.h>
+#include <lib/FileUtils.h>
+#include <lib/MappedFile.h>
+
+// Binary cache of fully imported model geometry, written next to the source file as <source>.meshcache.
+// An entry is only used if it was written for the same source path, file size, import flags and Vertex
+// layout, and the source either has the same modification time or, after a copy, the same content hash;
+// the same goes for every other file the import read, such as material libraries. Anything else counts as
+// a miss and the model is re-imported.
+class MeshCache {
+public:
+
+    static const unsigned int Version = 7;
+
+    // maps the cache file for the given source and validates it, returns false on a miss
+    bool Open(const string& sourcePath, unsigned int importFlags);
+    void Close();
+
+    // one view per cached mesh, pointing straight into the mapped file, with its geometry hashed on open. Only
+    // texture type and path are stored, so texture ids have to be resolved by the caller.
+    const vector<MeshView>& Entries() const;
+    // the files besides the source the cached import read
+    const vector<string>& Dependencies() const;
+
+    // dependencies are the files besides sourcePath the import read, each of which has to be unchanged as well
+    static bool Store(const string& sourcePath, unsigned int importFlags, const vector<MeshData>& meshes, const vector<string>& dependencies);
+    static string CachePathFor(const string& sourcePath);
+
+private:
+
+    MappedFile m_file;
+    vector<MeshView> m_entries;
+    vector<string> m_dependencies;
+
+};
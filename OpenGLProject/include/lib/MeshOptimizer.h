@@ -0,0 +1,64 @@
+#pragma once
+
+#include <lib/Mesh.h>
+
+// size of the simulated post-transform vertex cache; 16 entries or more on current GPUs
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// largest difference per vertex component (position, normal, uv, tangent frame) that still welds two vertices
+const float WELD_EPSILON = 1e-5f;
+
+// Vertex and triangle counts before and after WeldMesh.
+struct WeldStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    size_t trianglesBefore = 0;
+    size_t trianglesAfter = 0;
+
+    // fraction of vertices/triangles removed
+    float VertexReduction() const;
+    float TriangleReduction() const;
+};
+
+// How well an index order reuses the post-transform vertex cache, simulated as a FIFO of VERTEX_CACHE_SIZE entries.
+struct VertexCacheStats {
+    size_t transformedVertices = 0;
+    size_t triangles = 0;
+    size_t vertices = 0;
+
+    // average cache miss ratio: vertices shaded per triangle, 0.5 at best for a regular grid, 3 at worst
+    float ACMR() const;
+    // average transform to vertex ratio: how often each vertex is shaded, 1 at best
+    float ATVR() const;
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other);
+};
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+// merges vertices whose components all round to the same multiple of epsilon (bit identical ones with an epsilon of 0)
+// and points the indices at the first of each group
+void WeldVertices(vector<Vertex>& vertices, vector<unsigned int>& indices, float epsilon = WELD_EPSILON);
+
+// drops triangles that use a vertex twice, have no area or repeat an earlier triangle with the same winding, then the
+// vertices no triangle uses anymore
+void RemoveDegenerateTriangles(vector<Vertex>& vertices, vector<unsigned int>& indices);
+
+// welds an imported mesh and removes its degenerate triangles
+WeldStats WeldMesh(MeshData& mesh, float epsilon = WELD_EPSILON);
+
+// reorders the triangles of a triangle list for the post-transform vertex cache (Tipsify, Sander et al. 2007).
+// Fills clusterStarts, if given, with the first index of each run that starts with a cold cache.
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, vector<size_t>* clusterStarts = nullptr);
+
+// reorders clusters of a cache optimized triangle list so outward facing ones are drawn first and hide what is
+// behind them. Runs are split further where each part keeps an ACMR within threshold times that of its run.
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    const vector<size_t>& clusterStarts, float threshold = 1.05f);
+
+// renumbers vertices in the order the index list first uses them so vertex fetch walks memory linearly.
+// Unreferenced vertices are kept, after the referenced ones.
+void OptimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices);
+
+// runs all of the above on an imported mesh and returns the cache statistics before and after
+void OptimizeMesh(MeshData& mesh, VertexCacheStats& before, VertexCacheStats& after);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <lib/Mesh.h>
+
+// levels of detail per mesh, the full mesh included
+const size_t MAX_MESH_LODS = 5;
+// each level aims for this fraction of the previous level's triangles
+const float MESH_LOD_REDUCTION = 0.5f;
+// meshes aren't simplified below this many triangles
+const size_t MIN_LOD_TRIANGLES = 32;
+
+// Quadric error metric simplification (Garland and Heckbert 1997) that collapses vertices onto one of their neighbours,
+// so the result indexes the same vertex buffer. Vertices on open borders and where several attribute seams meet are
+// never moved; the two vertices on either side of a simple seam only move together, along the seam.
+// Stops at targetIndexCount indices, or earlier once no collapse is left, and returns the largest error a collapse
+// introduced as an object space distance: the area weighted RMS distance of the kept vertex to the planes it replaced.
+float SimplifyMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+    size_t targetIndexCount, vector<unsigned int>& result);
+
+// appends up to MAX_MESH_LODS - 1 simplified, cache optimized index lists to mesh.indices and describes
+// every level, the full mesh first, in mesh.lods
+void BuildMeshLods(MeshData& mesh);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <lib/Mesh.h>
+
+// cluster size limits, the usual choice for mesh shader hardware and a good culling granularity on the CPU as well
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+// meshes with fewer clusters than this aren't split, culling them as a whole costs less
+const size_t MIN_MESHLETS = 4;
+
+// splits the full level of detail of an imported mesh into meshlets of neighbouring triangles with similar normals and
+// fills mesh.meshlets. Reorders that level's triangles so every meshlet's are contiguous in mesh.indices.
+void BuildMeshlets(MeshData& mesh);
+
+// planes of the frustum of a view projection (times model) matrix, normals pointing inwards and of unit length,
+// in the space the matrix transforms from
+void ExtractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]);
+
+// false if the meshlet is outside one of the planes, or every one of its triangles faces away from viewer.
+// viewer and planes are in the mesh's object space.
+bool IsMeshletVisible(const Meshlet& meshlet, const glm::vec3& viewer, const glm::vec4 planes[6]);
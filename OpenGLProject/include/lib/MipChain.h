@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+enum MipFilter {
+    // 2x2 average, what glGenerateMipmap does on most drivers; cheapest to build
+    MIP_FILTER_BOX,
+    // Kaiser windowed sinc, keeps smaller levels noticeably sharper at a few times the cost
+    MIP_FILTER_KAISER
+};
+
+// Read-only view of one level, e.g. inside a memory mapped texture cache. RGBA8 unless its owner says it
+// stores fewer channels.
+struct MipLevelView {
+    int width;
+    int height;
+    const unsigned char* pixels;
+};
+
+// One level of an uncompressed RGBA8 mip chain.
+struct MipLevel {
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+
+    MipLevelView View() const;
+};
+
+// builds every level from width x height RGBA8 pixels down to 1x1, level 0 is a copy of the input.
+// Each level halves the previous one (rounding down) and the filter clamps at the edges.
+std::vector<MipLevel> BuildMipChain(const unsigned char* rgba, int width, int height, MipFilter filter = MIP_FILTER_BOX);
@@ -4,6 +4,8 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <glad/glad.h>
@@ -14,10 +16,22 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <lib/Camera.h>
+#include <lib/ImportProfile.h>
+#include <lib/MappedIOSystem.h>
 #include <lib/Mesh.h>
+#include <lib/MeshCache.h>
+#include <lib/MeshOptimizer.h>
+#include <lib/MeshSimplifier.h>
+#include <lib/Meshlet.h>
+#include <lib/ModelImporter.h>
 #include <lib/Shader.h>
+#include <lib/TextureLoader.h>
+#include <lib/TextureRegistry.h>
+#include <lib/VirtualTextureCache.h>
 
-inline unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+// largest RMS simplification error, in pixels, a level of detail may show on screen
+const float LOD_PIXEL_ERROR = 1.0f;
 
 class Model
 {
@@ -27,25 +41,125 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // skip the meshlets that are off screen or face away when drawing a mesh's full level of detail
+    bool meshletCulling;
+    // CPU geometry each mesh keeps after its upload
+    MeshResidency residency;
+    // post-processing steps the model is imported with
+    ImportProfile importProfile;
+    // vertex attributes the meshes upload: what the shader the model is loaded for reads, all of them without one.
+    // The import still generates every stream of the profile, its mesh cache is shared with AssetCooker and other shaders.
+    VertexStreams vertexStreams;
+    // files the last import read, the model first; empty if it came from the mesh cache
+    vector<string> sourceFiles;
 
+    // object space bounds of all meshes together
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    // Resident memory of the model. Texture arrays count in full even when other models share them, virtual textures
+    // not at all since they live in the VirtualTextureCache atlas.
+    struct MemoryStats {
+        size_t cpuBytes;
+        size_t gpuBytes;
+    };
+
+    // with a shader, only the textures its active samplers read are loaded, the others on the first Draw with a
+    // program that samples them, and the meshes only get the vertex streams it reads. Without one everything is loaded.
+    // The samplers are matched without a name prefix, SetShaderTextureNamePrefix comes too late for the constructor.
+    Model(string const& path, bool gamma = false, MeshResidency residency = MESH_RESIDENCY_KEEP, ImportProfile profile = IMPORT_PROFILE_RUNTIME,
+        const Shader* shader = nullptr);
+    // releases this model's references on the shared textures, needs the GL context to still be alive
+    ~Model();
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
 
-    Model(string const& path, bool gamma = false);
     void Draw(Shader& shader);
-    void SetShaderTextureNamePrefix(std::string prefix); 
+    // draws every mesh at the coarsest level of detail whose error stays within maxPixelError pixels for this camera
+    // and a viewportHeight pixels tall viewport, culling meshlets of the full level against the viewProjection
+    // frustum. Returns the number of triangles drawn.
+    size_t Draw(Shader& shader, const glm::mat4& modelMatrix, const glm::mat4& viewProjection, const Camera& camera, float viewportHeight,
+        float maxPixelError = LOD_PIXEL_ERROR);
+    // prefix of the sampler uniforms the meshes bind their textures to. A streamed model picks the textures it loads up
+    // front by the prefixed names, so set it right after ModelStreamer::Load; textures left out by an earlier prefix
+    // are loaded on the first Draw that samples them.
+    void SetShaderTextureNamePrefix(std::string prefix);
+
+    // a streamed model draws nothing until it is ready, its bounds are known a bit earlier (see ModelStreamer)
+    bool IsReady() const;
+    bool HasBounds() const;
+
+    MemoryStats GetMemoryStats() const;
 
 private:
+    friend class ModelStreamer;
+    friend class HotReloader;
+
+    bool ready;
+    bool boundsKnown;
+    // whether a ModelStreamer loads the textures Draw requests, otherwise Draw loads them itself
+    bool streamed;
+    // changes with every swapContents, textures loaded for the contents before it don't belong to the model anymore
+    unsigned int contentsVersion;
+    string textureNamePrefix;
+    // TextureRegistry::Generation the texture slots were last looked up at
+    unsigned int textureGeneration;
+
+    // position of each texture in textures_loaded, by loadedKeyFor. A file used as two types is loaded for each,
+    // like TextureRegistry keys it by usage.
+    unordered_map<string, size_t> texturesLoadedIndex;
+
+    // positions in textures_loaded of the textures no model had loaded yet and nothing loads so far, they get their
+    // slots once packed
+    vector<size_t> pendingTextures;
+
+    // whether every texture is loaded up front, otherwise only those loadSamplers read
+    bool loadAllTextures;
+    unordered_set<string> loadSamplers;
+    // positions in textures_loaded of the textures no sampler read so far, they have no slot and hold no reference
+    unordered_set<size_t> deferredTextures;
+    // programs whose samplers were checked against deferredTextures already
+    unordered_set<unsigned int> checkedPrograms;
+
+    // empty model that ModelStreamer fills in over several frames
+    Model();
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path);
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode* node, const aiScene* scene);
+    // GL half of loading: creates mesh i of an import whose textures are resolved already. A freshly imported mesh
+    // moves its geometry into the Mesh, so import.meshes[i] must not be read afterwards.
+    void uploadMesh(ModelImport& import, size_t i);
+    void resolveTextures(MeshView& view);
+    // takes the samplers textures are loaded for and the vertex streams from the shader, everything without one
+    void setTargetShader(const Shader* shader);
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
-    
-};
+    // returns the texture at the given path. Textures that aren't sampled are only recorded. New sampled textures
+    // are taken from the shared TextureRegistry and queued for loading only if no model in the process has loaded
+    // them yet.
+    Texture loadMaterialTexture(const string& path, const string& typeName, bool sampled);
+    // takes the reference on textures_loaded[index], or queues it for loading
+    void acquireTexture(size_t index);
+    // the file and usage the TextureRegistry knows the texture by
+    TextureSource sourceOf(const Texture& texture) const;
+    // key of a texture in texturesLoadedIndex
+    static string loadedKeyFor(const string& path, const string& type);
+    // acquires the deferred textures the shader's program samples. What no model had loaded yet is left pending for
+    // the ModelStreamer, or loaded right away, blocking, if the model isn't streamed. Meshes draw with a placeholder
+    // until then.
+    void requestSampledTextures(Shader& shader);
 
+    // loads the pending textures, blocking until they are uploaded
+    void loadPendingTextures();
+    // hands the packed slots of the textures at indices in textures_loaded to them and the meshes
+    void applyTextureSlots(const vector<size_t>& indices, const vector<TextureSlot>& slots);
+    // copies the slots in textures_loaded to the meshes' textures
+    void syncMeshTextures();
 
+    // looks up the slots of textures that moved since the last call, see TextureRegistry::MoveLayer
+    void refreshTextureSlots();
+    // exchanges everything loaded with other, a fresh load of the same file; settings like the residency stay
+    void swapContents(Model& other);
+    
+};
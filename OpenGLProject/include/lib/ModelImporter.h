@@ -0,0 +1,26 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <lib/Mesh.h>
+#include <lib/MeshCache.h>
+
+// Everything the CPU half of loading a model produces. Mesh geometry lives either in the mapped
+// cache or in the imported vector, and the views point into whichever one was used. Imported
+// geometry is moved into the meshes on upload rather than copied.
+struct ModelImport {
+    MeshCache        cache;
+    vector<MeshData> imported;
+    vector<MeshView> meshes;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // files assimp read, the model itself first; the cache records them for the next run
+    vector<string> sourceFiles;
+};
+
+// CPU half of loading a model: reads a valid mesh cache next to the file, unless useCache is false, or imports it
+// with ASSIMP, runs the mesh optimizations and writes the cache. Import statistics go to log. Touches no GL state,
+// so it can run on any thread, several imports at once included.
+bool ImportModel(const string& path, unsigned int importFlags, ModelImport& result, bool useCache = true, std::ostream& log = std::cout);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <lib/Model.h>
+
+// Loads models without blocking the frame loop. Import (or mesh cache read) and texture decode run
+// on the shared thread pool, while Update() does the GPU uploads on the GL thread, a mesh at a time
+// until the per-frame time budget is used up, then a model's textures once all of them decoded (they are packed
+// into texture arrays by layout), an array allocation or a layer at a time. The textures a loaded model's Draw
+// requests later, see Model, are streamed the same way; the meshes draw with a placeholder until they are uploaded.
+class ModelStreamer {
+public:
+
+    ~ModelStreamer();
+
+    // returns right away; the model draws nothing until IsReady(), its bounds become available
+    // (HasBounds()) as soon as the import finishes, e.g. for drawing a proxy box. Without useCache the
+    // model is imported even if its mesh cache looks valid, e.g. because a material library changed. With a shader
+    // only the textures it samples are streamed, see Model.
+    std::shared_ptr<Model> Load(const string& path, bool gamma = false, MeshResidency residency = MESH_RESIDENCY_KEEP,
+        ImportProfile profile = IMPORT_PROFILE_RUNTIME, bool useCache = true, const Shader* shader = nullptr);
+    // loads the file again past the mesh cache, into a new model with the settings model was loaded with
+    std::shared_ptr<Model> Reload(const Model& model, const string& path);
+    // streams the textures Draw requests for a model that was constructed directly, like for the ones Load returns
+    void Track(const std::shared_ptr<Model>& model);
+
+    // call once per frame on the GL thread
+    void Update(double budgetSeconds);
+
+    bool IsIdle() const;
+
+private:
+
+    struct Job;
+    vector<std::shared_ptr<Job>> m_jobs;
+    // models whose requested textures are streamed
+    vector<std::weak_ptr<Model>> m_models;
+
+    // starts importing the file into the empty model, whose settings are all set
+    void start(const std::shared_ptr<Model>& model, const string& path, bool useCache);
+    // starts loading the textures the ready model has pending
+    void startTextures(const std::shared_ptr<Model>& model);
+    // takes over the model's pending textures and starts decoding them
+    static void decodeTextures(const std::shared_ptr<Job>& job);
+    // returns true once the job is done (or failed) and can be dropped
+    bool advance(const std::shared_ptr<Job>& job, double deadline);
+
+};
@@ -4,6 +4,8 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <unordered_set>
+#include <vector>
 
 #include <GLAD/glad.h>
 #include <glm/glm.hpp>
@@ -20,6 +22,11 @@ public:
     void useProgram();
     void deleteProgram();
     unsigned int GetID();
+    // names of the sampler uniforms the linked program reads; ones the compiler optimized out aren't listed
+    const std::unordered_set<std::string>& GetActiveSamplers() const;
+    bool IsSamplerActive(const std::string& name) const;
+    // locations of the vertex attributes the linked program reads
+    const std::vector<GLint>& GetActiveAttributeLocations() const;
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
     void setFloat(const std::string& name, float value) const;
@@ -36,7 +43,11 @@ public:
 private:
 
     unsigned int m_id;
+    std::unordered_set<std::string> m_activeSamplers;
+    std::vector<GLint> m_activeAttributeLocations;
 
+    void collectActiveSamplers();
+    void collectActiveAttributes();
     void checkCompileErrors(GLuint shader, std::string type);
 
 };
\ No newline at end of file
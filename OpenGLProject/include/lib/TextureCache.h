@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <lib/FileUtils.h>
+#include <lib/ImageChannels.h>
+#include <lib/MappedFile.h>
+#include <lib/MipChain.h>
+
+// Decoded images with their whole mip chain, cached next to the source as <source>.texcache so warm starts
+// skip the image decode, mip generation and channel analysis. Every level holds only the channels the
+// texture stores, packed the way they are uploaded. The cache is only used if it was written for the same
+// source path, modification time, file size and mip filter.
+class TextureCache {
+public:
+
+    static const unsigned int Version = 2;
+
+    // maps the cache file for the given source and validates it, returns false on a miss
+    bool Open(const std::string& sourcePath, MipFilter filter);
+    void Close();
+
+    // channel count of the source image
+    int Components() const;
+    // the channels the levels store, Channels().count bytes per pixel
+    const ChannelLayout& Channels() const;
+    // level 0 first, pointing straight into the mapped file
+    const std::vector<MipLevelView>& Levels() const;
+
+    // chain holds channels.count bytes per pixel, as PackChannels leaves them
+    static bool Store(const std::string& sourcePath, MipFilter filter, int components, const ChannelLayout& channels, const std::vector<MipLevel>& chain);
+    static std::string CachePathFor(const std::string& sourcePath);
+
+private:
+
+    MappedFile m_file;
+    int m_components = 0;
+    ChannelLayout m_channels;
+    std::vector<MipLevelView> m_levels;
+
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <lib/CompressedTexture.h>
+#include <lib/ImageChannels.h>
+#include <lib/MipChain.h>
+#include <lib/TextureCache.h>
+#include <lib/TextureRegistry.h>
+
+// Image ready for upload: either an RGBA8 mip chain, or block compressed data with its
+// mip chain (compressed.format != 0) read from a DDS/KTX file.
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    // channel count of the source
+    int components = 0;
+    // channels the texture stores and how sampling rebuilds the rest, decides the GL internal format. For
+    // uncompressed levels it's what AnalyzeChannels found in the image, for compressed data what its format holds.
+    ChannelLayout channels;
+    // uncompressed levels with only the stored channels, channels.count bytes per pixel, pointing into mips
+    // when they were just built or into the mapped cache
+    std::vector<MipLevelView> levels;
+    std::vector<MipLevel> mips;
+    std::shared_ptr<TextureCache> cache;
+    CompressedImage compressed;
+    // TextureRegistry::HashImage of the file, taken by DecodeAndHashImage
+    bool hashed = false;
+    ContentHash content;
+
+    DecodedImage() = default;
+    DecodedImage(DecodedImage&&) = default;
+    DecodedImage& operator=(DecodedImage&&) = default;
+    // a copy's levels would still point into the original's mips
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage& operator=(const DecodedImage&) = delete;
+
+    bool IsDecoded() const { return !levels.empty() || compressed.format != 0; }
+};
+
+// A decode/upload job: the file at path ends up in the already generated texture object textureID.
+struct TextureLoadRequest {
+    unsigned int textureID;
+    std::string path;
+};
+
+// queries which block compressed formats the context supports and loads glTexStorage2D/3D through loadProc
+// if the context has them (glad only loads GL 3.3). Call once after the GL context is created; until then
+// DDS/KTX files are ignored and only the regular image files are used.
+void DetectTextureSupport(GLADloadproc loadProc);
+bool IsTextureFormatSupported(GLenum format);
+
+// decodes a PNG/JPEG/... file and builds its mip chain, safe to call from any thread. A DDS/KTX file with
+// the same name next to it is used instead if it is at least as new as the image, the context supports its
+// format and preferCooked is set (a hot reload clears it, the cooked file predates the edit), otherwise the
+// decoded chain is read from (or written to) the image's TextureCache.
+bool DecodeImage(const std::string& path, DecodedImage& image, bool preferCooked = true);
+// only the image's TextureCache, mapped rather than read into memory; false if there is no valid one. Any thread.
+bool MapCachedImage(const std::string& path, DecodedImage& image);
+// DecodeImage, then the content hash the TextureRegistry shares textures by, for images that get registered.
+// Any thread.
+bool DecodeAndHashImage(const std::string& path, DecodedImage& image, bool preferCooked = true);
+void FreeImage(DecodedImage& image);
+
+// uploads every level of the image into the given texture, into immutable storage when the context
+// supports it. GL thread only.
+void UploadTexture(unsigned int textureID, const DecodedImage& image);
+
+// GL internal format, swizzle, size and level count the image is uploaded with
+TextureLayout LayoutOf(const DecodedImage& image);
+
+// allocates the texture array textureID with one layer per image, which must all have the same layout, and
+// uploads them. GL thread only.
+void UploadTextureArray(unsigned int textureID, const std::vector<const DecodedImage*>& images);
+// uploads the image into one layer of an existing texture array of the same layout. GL thread only.
+void UploadTextureLayer(unsigned int textureID, unsigned int layer, const DecodedImage& image);
+
+// uploads the decoded images of the files into as few texture arrays as their layouts allow and registers them
+// with the TextureRegistry. Files another caller loaded in the meantime, or whose hashed contents are loaded for
+// the same usage, are acquired instead; files that failed to decode get id 0. Frees the images. GL thread only.
+std::vector<TextureSlot> PackTextures(const std::vector<TextureSource>& sources, std::vector<DecodedImage>& images);
+
+// PackTextures in steps, so a streamer can spread the uploads over frames: Begin acquires what is loaded already and
+// groups the rest by layout, every Step then allocates one array or uploads one layer into it. Files another packer
+// added in the meantime are acquired when their array is allocated. An array is registered when it is allocated, so a
+// model acquiring one of its files meanwhile may sample layers that are still being uploaded, for the few frames that
+// takes. Dropped before Finish, the packer releases the references it took.
+// GL thread only.
+class TexturePacker {
+public:
+
+    TexturePacker();
+    ~TexturePacker();
+    TexturePacker(const TexturePacker&) = delete;
+    TexturePacker& operator=(const TexturePacker&) = delete;
+
+    void Begin(const std::vector<TextureSource>& sources, std::vector<DecodedImage> images);
+    // does one allocation or upload, returns false once nothing is left to do
+    bool Step();
+    // one slot per file as PackTextures returns them, once Step returned false
+    std::vector<TextureSlot> Finish();
+
+private:
+
+    struct Group {
+        TextureLayout layout;
+        std::vector<size_t> members;
+        // 0 until the array is allocated
+        unsigned int textureID;
+    };
+
+    std::vector<TextureSource> m_sources;
+    std::vector<DecodedImage> m_images;
+    std::vector<TextureSlot> m_slots;
+    std::vector<Group> m_groups;
+    // next layer to upload
+    size_t m_group;
+    size_t m_layer;
+
+};
+// decodes and hashes the files on the shared thread pool, and on the calling thread rather than waiting for a busy
+// pool, then packs them. Returns once every texture is uploaded; never waits on a decode that hasn't started.
+std::vector<TextureSlot> LoadTextureArrays(const std::vector<TextureSource>& sources);
+
+// decodes all requests on the shared thread pool while the calling (GL) thread uploads each texture as soon as
+// its decode finishes, decoding the rest itself when none has. Returns once every texture is uploaded.
+void LoadTextures(const std::vector<TextureLoadRequest>& requests);
+
+unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma = false);
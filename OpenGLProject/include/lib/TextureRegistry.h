@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <lib/ContentHash.h>
+
+// Where a file texture lives on the GPU: a layer of a GL_TEXTURE_2D_ARRAY.
+struct TextureSlot {
+    unsigned int id = 0;
+    unsigned int layer = 0;
+};
+
+// A file as a material samples it. The same file is shared per usage only, see TextureRegistry::Usage.
+struct TextureSource {
+    std::string path;
+    std::string usage;
+};
+
+// Storage of a texture array, which every one of its layers has: images with the same layout can share an array.
+struct TextureLayout {
+    GLenum internalFormat = 0;
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+    // GL_TEXTURE_SWIZZLE_R/G/B/A, rebuilds the channels a reduced internal format doesn't store
+    GLenum swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+
+    bool operator==(const TextureLayout& other) const {
+        return internalFormat == other.internalFormat && width == other.width && height == other.height && levels == other.levels
+            && swizzle[0] == other.swizzle[0] && swizzle[1] == other.swizzle[1] && swizzle[2] == other.swizzle[2] && swizzle[3] == other.swizzle[3];
+    }
+    bool operator!=(const TextureLayout& other) const { return !(*this == other); }
+};
+
+// Process wide registry of file textures, so models sharing a material library share the GPU textures too.
+// Files are keyed by canonical path and usage, and by the content hash of the image (and of the cooked versions
+// next to it) and usage, so identical images under different names, e.g. in copies of an asset kit, share one
+// texture as well. The hashes are taken by the decoders, see DecodeAndHashImage, never on the GL thread.
+// Every file is a layer of a texture array, see PackTextures; files sharing contents share the layer. References are
+// counted per file, so a file can leave its layer; the GL texture is deleted once none of its layers has a reference
+// left. GL thread only.
+class TextureRegistry {
+public:
+
+    struct Stats {
+        size_t hits;           // acquires served by an existing texture
+        size_t contentHits;    // hits found by content, i.e. through another file with the same bytes
+        size_t misses;         // acquires of files that had to be loaded
+        size_t textures;       // live layers
+        size_t arrays;         // live texture arrays holding them
+        size_t residentBytes;  // GPU memory of all live textures, mipmaps included
+        size_t reusedBytes;    // GPU memory that hits didn't have to allocate again
+    };
+
+    static TextureRegistry& Instance();
+
+    // how a material samples a file: its texture type ("texture_diffuse", ...) and whether the model is gamma
+    // corrected. A file used for two purposes is loaded once for each.
+    static std::string Usage(const std::string& type, bool gamma);
+
+    // takes a reference on the texture loaded from the file for the same usage and returns true with its slot. Given
+    // the content hash of the decoded file, a texture loaded from another file with the same bytes serves as well.
+    // Returns false if the file still has to be uploaded and added with AddArray.
+    bool Acquire(const TextureSource& source, TextureSlot& slot, const ContentHash* content = nullptr);
+    // registers the texture array textureID, whose layers hold the files in order, with one reference on each layer.
+    // contents are their hashes, null where there is none.
+    void AddArray(unsigned int textureID, const std::vector<TextureSource>& sources, const std::vector<const ContentHash*>& contents,
+        const TextureLayout& layout);
+    // drops a reference Acquire or AddArray took for the file
+    void Release(const TextureSource& source);
+
+    // called whenever a texture's storage is (re)specified, ids the registry doesn't know are ignored
+    void RecordUpload(unsigned int textureID, size_t bytes);
+
+    // slot of the live texture loaded from the file for the usage, id 0 if there is none
+    TextureSlot Find(const TextureSource& source) const;
+    // usages the file is loaded for
+    std::vector<std::string> Usages(const std::string& path) const;
+    // layout of a live texture array, null for ids the registry doesn't know
+    const TextureLayout* Layout(unsigned int textureID) const;
+
+    // whether other files with the same contents share the file's layer, which then mustn't change with the file
+    bool IsShared(const TextureSource& source) const;
+    // after the file's layer was uploaded again with new contents of the same layout, which hash to content
+    void Rehash(const TextureSource& source, const ContentHash* content);
+    // moves the file, its references included, to newID: a one layer array the caller just created for new contents
+    // that no longer fit the old layout, or that the other files on the old layer don't have. content is their hash.
+    // Holders of the old slot look it up again once Generation changes.
+    void MoveTexture(const TextureSource& source, unsigned int newID, const TextureLayout& layout, const ContentHash* content);
+    // changes with every MoveTexture
+    unsigned int Generation() const;
+
+    Stats GetStats() const;
+    // GPU memory of one live texture array, 0 for ids the registry doesn't know
+    size_t TextureBytes(unsigned int textureID) const;
+
+    static std::string CanonicalPath(const std::string& path);
+    // hash of the image file and of the .ktx/.dds next to it that DecodeImage would prefer, false if unreadable.
+    // Reads the whole file, so it's taken on the decode workers.
+    static bool HashImage(const std::string& path, ContentHash& hash);
+
+private:
+
+    struct Layer {
+        // references of every file and usage the layer serves, by keyFor
+        std::unordered_map<std::string, unsigned int> references;
+        std::string usage;
+        bool hashed;
+        // contentKeyFor the layer's bytes and usage
+        ContentHash content;
+        // all references together
+        unsigned int refCount;
+    };
+
+    struct Entry {
+        std::vector<Layer> layers;
+        // references on all layers together
+        unsigned int refCount;
+        TextureLayout layout;
+        size_t bytes;
+    };
+
+    std::unordered_map<std::string, TextureSlot> m_slotsByPath;
+    std::unordered_map<ContentHash, TextureSlot> m_slotsByContent;
+    std::unordered_map<unsigned int, Entry> m_entries;
+    unsigned int m_generation;
+    Stats m_stats;
+
+    TextureRegistry();
+
+    static std::string keyFor(const TextureSource& source);
+    static ContentHash contentKeyFor(const ContentHash& content, const std::string& usage);
+
+    // makes the layer's paths and contents point at slot
+    void mapLayer(const Layer& layer, const TextureSlot& slot);
+    void unmapLayer(const Layer& layer, const TextureSlot& slot);
+    // the layer the file is mapped to, null if there is none
+    Layer* layerOf(const std::string& key, TextureSlot& slot);
+    // takes count references of the file off its layer, which is unmapped once it has none left
+    void dropReferences(const std::string& key, unsigned int count);
+    void releaseEntry(std::unordered_map<unsigned int, Entry>::iterator entry);
+
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads running jobs in submission order.
+class ThreadPool {
+public:
+
+    explicit ThreadPool(unsigned int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> job);
+    unsigned int ThreadCount() const;
+
+    // runs body(i) for every i in [0, count) on the workers and returns once all calls are done.
+    // Must not be called from a job of the same pool, the waiting worker could starve it.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    // process wide pool with one worker per core, minus one for the GL thread
+    static ThreadPool& Shared();
+
+private:
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_stopping;
+
+    void workerLoop();
+
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// texels of a virtual texture page, and the border copied around it from its neighbours so bilinear filtering
+// never reads another page's texels in the atlas
+const int VIRTUAL_PAGE_SIZE = 120;
+const int VIRTUAL_PAGE_BORDER = 4;
+// side of a tile in the physical atlas: one page and its border
+const int VIRTUAL_TILE_SIZE = VIRTUAL_PAGE_SIZE + 2 * VIRTUAL_PAGE_BORDER;
+// diffuse maps larger than this on either side are paged once the cache is enabled
+const int VIRTUAL_TEXTURE_MIN_SIZE = 2048;
+// the feedback pass renders at 1/VIRTUAL_FEEDBACK_SCALE of the viewport on each side
+const int VIRTUAL_FEEDBACK_SCALE = 8;
+
+// Software virtual texturing for images too large to keep on the GPU in full. Every level of the image's mip chain
+// is cut into pages, and only the pages something on screen samples are copied into tiles of one physical atlas
+// shared by all virtual textures, whose size is the fixed GPU budget. A page table texture per image (a mip chain
+// of one texel per page) points the shader at the tile of each page, or at the finest resident page covering it
+// while it isn't loaded; the page covering the whole image at its coarsest level is always resident.
+// Which pages are needed comes from a feedback pass: the scene is drawn into a small framebuffer with
+// virtualFeedbackFragmentShader.fs.glsl, which writes the page every pixel of a virtual texture samples and nothing
+// for everything else, so occluded pages aren't requested. The result is read back a frame later without stalling. Update loads the missing pages, coarse ones first, in place of the least recently requested
+// ones. The source images stay on the CPU as their memory-mapped TextureCache files. A file that changed on disk is
+// decoded again with Reload, the old pages stay in use until the new image is ready. GL thread only.
+class VirtualTextureCache {
+public:
+
+    struct Stats {
+        size_t textures;       // live virtual textures
+        size_t tiles;          // tiles in the atlas
+        size_t residentPages;  // tiles holding a page
+        size_t requestedPages; // distinct pages the last feedback asked for, their coarser levels included
+        size_t pagesLoaded;    // pages copied into the atlas so far
+        size_t pagesEvicted;   // pages dropped so far to make room
+        size_t residentBytes;  // GPU memory of the atlas and the page tables
+    };
+
+    // what the shaders need to sample a virtual texture: its width, height and coarsest level, and the index its
+    // feedback is written with
+    struct Parameters {
+        glm::vec4 size;
+        float index;
+    };
+
+    static VirtualTextureCache& Instance();
+
+    // creates the atlas, as many tiles as fit into budgetBytes; until then no texture is paged. Returns false if it
+    // was enabled already.
+    bool Enable(size_t budgetBytes);
+    bool IsEnabled() const;
+
+    // whether the image file is large enough to be paged, only reads its header
+    bool ShouldPage(const std::string& path) const;
+
+    // takes a reference on the virtual texture of the file and returns the id of its page table, 0 if no more virtual
+    // textures fit. The image decodes on the shared pool; it samples as grey until Update made it resident.
+    unsigned int Acquire(const std::string& path);
+    void Release(unsigned int pageTableID);
+    // decodes the file of a live virtual texture again, once done Update replaces its pages; its page table id stays.
+    // Returns false if the file isn't paged.
+    bool Reload(const std::string& path);
+
+    // false for ids that aren't page tables of this cache
+    bool GetParameters(unsigned int pageTableID, Parameters& parameters) const;
+    unsigned int AtlasTexture() const;
+    // tiles on each side of the atlas
+    int AtlasTiles() const;
+
+    // binds the feedback framebuffer for a viewport of the given size and clears it; draw the whole scene with the
+    // feedback shader in between, occluders included. EndFeedback starts reading the result back and binds
+    // the previous framebuffer and viewport again.
+    void BeginFeedback(int viewportWidth, int viewportHeight);
+    void EndFeedback();
+    // added to the feedback shader's level of detail, the feedback pixels are VIRTUAL_FEEDBACK_SCALE times larger
+    static float FeedbackLodBias();
+
+    // makes decoded textures resident, takes the previous feedback and loads at most maxPages of the missing pages,
+    // then updates the page tables. Call once per frame.
+    void Update(size_t maxPages);
+
+    Stats GetStats() const;
+
+private:
+
+    struct Decode;
+    struct VirtualTexture;
+
+    struct ResidentPage {
+        int tile;
+        // Update the page was last requested in
+        unsigned int lastUsed;
+        // position in m_lru, end() for the pinned coarsest page of a texture
+        std::list<uint64_t>::iterator lru;
+    };
+
+    int m_atlasTiles;
+    unsigned int m_atlas;
+    std::vector<int> m_freeTiles;
+    // evictable resident pages, most recently requested first
+    std::list<uint64_t> m_lru;
+    std::unordered_map<uint64_t, ResidentPage> m_resident;
+    unsigned int m_updates;
+
+    std::unordered_map<std::string, std::shared_ptr<VirtualTexture>> m_byPath;
+    std::unordered_map<unsigned int, std::shared_ptr<VirtualTexture>> m_byPageTable;
+    // feedback index -> texture, null where free
+    std::vector<std::shared_ptr<VirtualTexture>> m_byIndex;
+
+    unsigned int m_feedbackFramebuffer;
+    unsigned int m_feedbackColor;
+    unsigned int m_feedbackDepth;
+    int m_feedbackWidth;
+    int m_feedbackHeight;
+    // pixel pack buffers read back into in turn, each with the size of the feedback it holds (0 if none)
+    unsigned int m_readbackBuffers[2];
+    int m_readbackWidth[2];
+    int m_readbackHeight[2];
+    int m_readbackNext;
+    GLint m_savedFramebuffer;
+    GLint m_savedViewport[4];
+    GLfloat m_savedClearColor[4];
+
+    // page staging for the atlas upload
+    std::vector<unsigned char> m_staging;
+    Stats m_stats;
+
+    VirtualTextureCache();
+
+    // decodes the texture's file on the shared pool, dropping the result of a decode still in flight
+    static void startDecode(VirtualTexture& texture);
+    void makeResident(VirtualTexture& texture);
+    // evicts every page of the texture, the pinned ones included
+    void dropPages(VirtualTexture& texture);
+    void readFeedback(std::vector<uint64_t>& missing);
+    void request(uint64_t key, std::vector<uint64_t>& missing);
+    bool loadPage(uint64_t key, bool pinned);
+    int allocateTile();
+    void evict(uint64_t key);
+    void updatePageTable(VirtualTexture& texture);
+    VirtualTexture* textureOf(uint64_t key) const;
+
+};
@@ -30,13 +30,30 @@ uniform vec3 viewPos;
 uniform DirLight dirLight;
 uniform PointLight pointLight;
 uniform vec3 lightColor;
-uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_specular1;
+// material textures are layers of texture arrays
+uniform sampler2DArray texture_diffuse1;
+uniform sampler2DArray texture_specular1;
+uniform float texture_diffuse1Layer;
+uniform float texture_specular1Layer;
+// a very large diffuse map is a virtual texture instead, see VirtualTextureCache.h
+uniform bool texture_diffuse1Virtual;
+uniform sampler2D texture_diffuse1PageTable;
+// width, height and coarsest level
+uniform vec4 texture_diffuse1VirtualSize;
+uniform sampler2D virtualAtlas;
+uniform float virtualAtlasTiles;
 uniform float shininess;
 
+// page layout of the virtual texture atlas, as in VirtualTextureCache.h
+const float VIRTUAL_PAGE_SIZE = 120.0;
+const float VIRTUAL_PAGE_BORDER = 4.0;
+const float VIRTUAL_TILE_SIZE = 128.0;
+
 // function prototypes
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec4 SampleVirtual(sampler2D pageTable, vec4 size, vec2 uv);
+vec3 Diffuse();
 
 void main()
 {    
@@ -60,9 +77,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = normalize(reflect(-lightDir, normal));
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(texture_diffuse1, myTexPos));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, myTexPos));
-    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, myTexPos));
+    vec3 ambient = light.ambient * Diffuse();
+    vec3 diffuse = light.diffuse * diff * Diffuse();
+    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, vec3(myTexPos, texture_specular1Layer)));
     return (ambient + diffuse + specular)*lightColor;
 }
 
@@ -79,11 +96,39 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(texture_diffuse1, myTexPos));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, myTexPos));
-    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, myTexPos));
+    vec3 ambient = light.ambient * Diffuse();
+    vec3 diffuse = light.diffuse * diff * Diffuse();
+    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, vec3(myTexPos, texture_specular1Layer)));
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
     return (ambient + diffuse*lightColor + specular*lightColor);
-}
\ No newline at end of file
+}
+
+// looks the page up in the page table, which points at the tile of the page or of the finest resident page
+// covering it, and samples the tile in the atlas
+vec4 SampleVirtual(sampler2D pageTable, vec4 size, vec2 uv)
+{
+    // the level of detail from the unwrapped coordinates, the wrap would show up as a seam
+    vec2 texel = uv * size.xy;
+    float lod = log2(max(length(dFdx(texel)), length(dFdy(texel))));
+    int level = int(clamp(floor(lod), 0.0, size.z));
+    uv = fract(uv);
+
+    vec2 levelSize = max(floor(size.xy / exp2(float(level))), 1.0);
+    vec4 entry = floor(texelFetch(pageTable, ivec2(uv * levelSize / VIRTUAL_PAGE_SIZE), level) * 255.0 + 0.5);
+    if (entry.a == 0.0)
+        return vec4(0.5); // still loading
+    vec2 residentSize = max(floor(size.xy / exp2(entry.b)), 1.0);
+    vec2 inPage = mod(uv * residentSize, VIRTUAL_PAGE_SIZE);
+    vec2 atlasTexel = entry.rg * VIRTUAL_TILE_SIZE + VIRTUAL_PAGE_BORDER + inPage;
+    // the atlas has no mipmaps, the page table picked the level
+    return textureLod(virtualAtlas, atlasTexel / (virtualAtlasTiles * VIRTUAL_TILE_SIZE), 0.0);
+}
+
+vec3 Diffuse()
+{
+    if (texture_diffuse1Virtual)
+        return vec3(SampleVirtual(texture_diffuse1PageTable, texture_diffuse1VirtualSize, myTexPos));
+    return vec3(texture(texture_diffuse1, vec3(myTexPos, texture_diffuse1Layer)));
+}
@@ -12,10 +12,26 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// quantized meshes store positions relative to their bounds, see Mesh::setupMesh
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+// packed meshes store normals octahedron encoded in xy
+uniform bool octahedralNormals;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 position = positionOffset + positionScale * aPos;
+    vec3 normal = octahedralNormals ? decodeOctahedral(aNormal.xy) : aNormal;
+    gl_Position = projection * view * model * vec4(position, 1.0);
     myTexPos = aTexPos;
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    myNormal = mat3(transpose(inverse(model))) * aNormal;
-}
\ No newline at end of file
+    FragPos = vec3(model * vec4(position, 1.0));
+    myNormal = mat3(transpose(inverse(model))) * normal;
+}
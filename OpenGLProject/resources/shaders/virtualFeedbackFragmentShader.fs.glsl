@@ -0,0 +1,37 @@
+#version 330 core
+
+// Writes the virtual texture page every pixel samples, see VirtualTextureCache::BeginFeedback. Drawn with the
+// model vertex shader into a framebuffer VIRTUAL_FEEDBACK_SCALE times smaller than the screen.
+
+out vec4 FragColor;
+
+in vec2 myTexPos;
+
+uniform bool texture_diffuse1Virtual;
+// width, height and coarsest level
+uniform vec4 texture_diffuse1VirtualSize;
+uniform float texture_diffuse1VirtualIndex;
+// makes up for the larger pixels of the feedback framebuffer
+uniform float feedbackLodBias;
+
+// as in VirtualTextureCache.h
+const float VIRTUAL_PAGE_SIZE = 120.0;
+
+void main()
+{
+    if (!texture_diffuse1Virtual)
+    {
+        FragColor = vec4(0.0);
+        return;
+    }
+
+    // the same level the model fragment shader picks
+    vec2 texel = myTexPos * texture_diffuse1VirtualSize.xy;
+    float lod = log2(max(length(dFdx(texel)), length(dFdy(texel)))) + feedbackLodBias;
+    float level = clamp(floor(lod), 0.0, texture_diffuse1VirtualSize.z);
+    vec2 levelSize = max(floor(texture_diffuse1VirtualSize.xy / exp2(level)), 1.0);
+    vec2 page = floor(fract(myTexPos) * levelSize / VIRTUAL_PAGE_SIZE);
+
+    // page x, page y, level, texture index plus one
+    FragColor = vec4(page, level, texture_diffuse1VirtualIndex + 1.0) / 255.0;
+}
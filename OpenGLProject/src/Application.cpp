@@ -36,6 +36,14 @@ int main() {
         return EXIT_FAILURE;
     }
 
+    //Find out which compressed texture formats and texture storage functions we can use
+
+    DetectTextureSupport((GLADloadproc)glfwGetProcAddress);
+
+    //Page very large textures through an atlas of fixed size instead of uploading them in full
+
+    VirtualTextureCache::Instance().Enable(VIRTUAL_TEXTURE_BUDGET);
+
     //Initialize new program state and if there is a file containing previous one read from it
 
     programState = new ProgramState;
@@ -65,10 +73,22 @@ int main() {
     Shader modelShader("resources/shaders/modelVertexShader.vs.glsl", "resources/shaders/modelFragmentShader.fs.glsl");
     Shader screenShader("resources/shaders/screenVertexShader.vs.glsl", "resources/shaders/screenFragmentShader.fs.glsl");
     Shader planeShader("resources/shaders/planeVertexShader.vs.glsl", "resources/shaders/planeFragmentShader.fs.glsl");
+    Shader feedbackShader("resources/shaders/modelVertexShader.vs.glsl", "resources/shaders/virtualFeedbackFragmentShader.fs.glsl");
 
-    //Load a model from given location
+    //Start loading a model from given location in the background, a proxy box is drawn until it's ready
+    //Nothing reads its geometry back once uploaded, so it keeps none on the CPU
+    //Only the textures modelShader samples are loaded, the normal maps stay on disk
+    //The streamer and the reloader hold GPU resources of the models in flight, so they are destroyed before the context
 
-    Model myModel("resources/objects/cyborg/cyborg.obj");
+    std::unique_ptr<ModelStreamer> modelStreamer(new ModelStreamer());
+    std::shared_ptr<Model> myModel = modelStreamer->Load("resources/objects/cyborg/cyborg.obj", false, MESH_RESIDENCY_DISCARD, IMPORT_PROFILE_RUNTIME, true, &modelShader);
+    std::shared_ptr<Model> planet = modelStreamer->Load("resources/objects/planet/planet.obj", false, MESH_RESIDENCY_DISCARD, IMPORT_PROFILE_RUNTIME, true, &modelShader);
+
+    //Pick up edits to the model and its textures while running
+
+    std::unique_ptr<HotReloader> hotReloader(new HotReloader());
+    hotReloader->Track(myModel, "resources/objects/cyborg/cyborg.obj");
+    hotReloader->Track(planet, "resources/objects/planet/planet.obj");
 
     //Declare all needed VBOs and VAOs
 
@@ -148,10 +168,15 @@ int main() {
         cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    //Load needed textures for drawing a cube
+    //Load needed textures for drawing a cube, both are decoded in parallel
 
-    unsigned int containerDiffuse = loadTexture("resources/textures/container2.png");
-    unsigned int containerSpecular = loadTexture("resources/textures/container2_specular.png");
+    unsigned int containerDiffuse, containerSpecular;
+    glGenTextures(1, &containerDiffuse);
+    glGenTextures(1, &containerSpecular);
+    LoadTextures({
+        { containerDiffuse, "resources/textures/container2.png" },
+        { containerSpecular, "resources/textures/container2_specular.png" }
+    });
     
     //Execute this loop until window is given a signal to close
 
@@ -172,6 +197,18 @@ int main() {
         
         update(window);
 
+        //Upload whatever part of the streamed models fits into this frame
+
+        modelStreamer->Update(STREAMING_BUDGET);
+
+        //Swap in models and textures that were changed on disk and have finished reloading
+
+        hotReloader->Update(STREAMING_BUDGET);
+
+        //Load the virtual texture pages the last feedback pass asked for
+
+        VirtualTextureCache::Instance().Update(VIRTUAL_PAGES_PER_FRAME);
+
         //Bind our framebuffer and clear the screen
 
         glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
@@ -246,6 +283,7 @@ int main() {
         model = glm::mat4(1.0f); //model transformation matrix
         model = glm::translate(model, glm::vec3(0.0f, -3.0f, -5.0f));
         model = glm::scale(model, glm::vec3(1.0f));
+        glm::mat4 myModelMatrix = model;
         modelShader.useProgram();
         modelShader.setMat4("model", model);
         modelShader.setMat4("view", view);
@@ -265,9 +303,30 @@ int main() {
         modelShader.setFloat("pointLight.linear", programState->pointLight.linear);
         modelShader.setFloat("pointLight.quadratic", programState->pointLight.quadratic);
 
-        //Draw a model
+        //Draw a model, or a box the size of it while it is still loading
 
-        myModel.Draw(modelShader);
+        if (myModel->IsReady()) {
+            myModel->meshletCulling = programState->meshletCulling;
+            programState->modelTriangles = myModel->Draw(modelShader, model, projection * view, camera, (float)viewPortDim[3]);
+            programState->modelMemory = myModel->GetMemoryStats();
+        }
+        else if (myModel->HasBounds()) {
+            glm::mat4 proxyModel = glm::translate(model, (myModel->boundsMin + myModel->boundsMax) * 0.5f);
+            proxyModel = glm::scale(proxyModel, myModel->boundsMax - myModel->boundsMin);
+            lightShader.useProgram();
+            lightShader.setMat4("model", proxyModel);
+            glBindVertexArray(lightVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
+
+        //Draw a planet, its large texture is paged in as far as it is seen
+
+        glm::mat4 planetMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(8.0f, 2.0f, -12.0f));
+        if (planet->IsReady()) {
+            modelShader.useProgram();
+            modelShader.setMat4("model", planetMatrix);
+            planet->Draw(modelShader, planetMatrix, projection * view, camera, (float)viewPortDim[3]);
+        }
 
         //Configure ground plane drawing
 
@@ -300,6 +359,46 @@ int main() {
         glBindVertexArray(planeVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
+        //Render which virtual texture pages the planet needs into the small feedback buffer, they are read back next frame.
+        //The whole scene goes in, so whatever hides the planet hides its pages too; only virtual textures write a page.
+
+        if (planet->IsReady()) {
+            VirtualTextureCache::Instance().BeginFeedback(viewPortDim[2], viewPortDim[3]);
+            feedbackShader.useProgram();
+            feedbackShader.setMat4("view", view);
+            feedbackShader.setMat4("projection", projection);
+            feedbackShader.setFloat("feedbackLodBias", VirtualTextureCache::FeedbackLodBias());
+
+            //The cubes and the plane have plain float positions and no virtual texture
+
+            feedbackShader.setVec3("positionOffset", glm::vec3(0.0f));
+            feedbackShader.setVec3("positionScale", glm::vec3(1.0f));
+            feedbackShader.setBool("octahedralNormals", false);
+            feedbackShader.setBool("texture_diffuse1Virtual", false);
+            glBindVertexArray(cubeVAO);
+            for (unsigned int i = 0; i < 6; i++)
+            {
+                glm::mat4 cubeModel = glm::translate(glm::mat4(1.0f), cubePositions[i]);
+                cubeModel = glm::rotate(cubeModel, glm::radians(20.0f * (i + 1)), glm::vec3(1.0f, 0.3f, 0.5f));
+                feedbackShader.setMat4("model", cubeModel);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+            feedbackShader.setMat4("model", glm::scale(glm::translate(glm::mat4(1.0f), programState->pointLight.position), glm::vec3(0.2f)));
+            glBindVertexArray(lightVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            feedbackShader.setMat4("model", model);
+            glBindVertexArray(planeVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+
+            if (myModel->IsReady()) {
+                feedbackShader.setMat4("model", myModelMatrix);
+                myModel->Draw(feedbackShader, myModelMatrix, projection * view, camera, (float)viewPortDim[3] / VIRTUAL_FEEDBACK_SCALE);
+            }
+            feedbackShader.setMat4("model", planetMatrix);
+            planet->Draw(feedbackShader);
+            VirtualTextureCache::Instance().EndFeedback();
+        }
+
         //If user pressed F1 enter console mode
 
         if(programState->imGuiEnabled)
@@ -345,10 +444,15 @@ int main() {
     glDeleteBuffers(1, &cubeVBO);
     glDeleteBuffers(1, &planeVBO);
     glDeleteBuffers(1, &quadVBO);
+    hotReloader.reset();
+    modelStreamer.reset();
+    myModel.reset();
+    planet.reset();
     cubeShader.deleteProgram();
     lightShader.deleteProgram();
     planeShader.deleteProgram();
     screenShader.deleteProgram();
+    feedbackShader.deleteProgram();
     glfwTerminate();
     return EXIT_SUCCESS;
 }
@@ -419,34 +523,12 @@ unsigned int loadTexture(char const* path)
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
+    DecodedImage image;
+    if (DecodeImage(path, image))
+        UploadTexture(textureID, image);
     else
-    {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+    FreeImage(image);
 
     return textureID;
 }
@@ -518,6 +600,17 @@ void DrawImGui(ProgramState* programState) {
         ImGui::ColorEdit3("Light color", (float*)&programState->lightColor);
         ImGui::DragFloat3("Point light position", (float*)value_ptr(programState->pointLight.position), 0.05, -100, 100);
         ImGui::DragFloat3("Directional light direction", (float*)value_ptr(programState->dirLight.direction), 0.01, -1, 1);
+        TextureRegistry::Stats textureStats = TextureRegistry::Instance().GetStats();
+        ImGui::Text("Textures: %zu in %zu arrays (%.1f MB), reused %.1f MB", textureStats.textures, textureStats.arrays, textureStats.residentBytes / (1024.0f * 1024.0f), textureStats.reusedBytes / (1024.0f * 1024.0f));
+        ImGui::Text("Texture cache hits/misses: %zu/%zu, %zu by content", textureStats.hits, textureStats.misses, textureStats.contentHits);
+        GeometryRegistry::Stats geometryStats = GeometryRegistry::Instance().GetStats();
+        ImGui::Text("Mesh buffers: %zu (%.1f MB), reused %.1f MB", geometryStats.geometries, geometryStats.residentBytes / (1024.0f * 1024.0f), geometryStats.reusedBytes / (1024.0f * 1024.0f));
+        VirtualTextureCache::Stats virtualStats = VirtualTextureCache::Instance().GetStats();
+        ImGui::Text("Virtual pages: %zu/%zu resident (%.1f MB), %zu requested, %zu loaded, %zu evicted", virtualStats.residentPages, virtualStats.tiles,
+            virtualStats.residentBytes / (1024.0f * 1024.0f), virtualStats.requestedPages, virtualStats.pagesLoaded, virtualStats.pagesEvicted);
+        ImGui::Checkbox("Meshlet culling", &programState->meshletCulling);
+        ImGui::Text("Model triangles: %zu", programState->modelTriangles);
+        ImGui::Text("Model memory: CPU %.1f MB, GPU %.1f MB", programState->modelMemory.cpuBytes / (1024.0f * 1024.0f), programState->modelMemory.gpuBytes / (1024.0f * 1024.0f));
         ImGui::End();
     }
 
@@ -0,0 +1,609 @@
+#include <lib/BlockCompression.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    // the 16 pixels of a 4x4 block with one array per channel, so SSE can work on four pixels at once
+    struct Block {
+        float channels[4][16];
+    };
+
+    // interpolation weight of endpoint1 for every index
+    const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    float clampChannel(float value) {
+        return std::min(std::max(value, 0.0f), 255.0f);
+    }
+
+    void loadBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, Block& block) {
+        for (int i = 0; i < 16; i++)
+        {
+            int x = std::min(blockX * 4 + i % 4, width - 1);
+            int y = std::min(blockY * 4 + i / 4, height - 1);
+            const unsigned char* pixel = rgba + ((size_t)y * width + x) * 4;
+            for (int c = 0; c < 4; c++)
+                block.channels[c][i] = pixel[c];
+        }
+    }
+
+    void storeBlock(const unsigned char pixels[64], int width, int height, int blockX, int blockY, unsigned char* rgba) {
+        for (int i = 0; i < 16; i++)
+        {
+            int x = blockX * 4 + i % 4;
+            int y = blockY * 4 + i / 4;
+            if (x < width && y < height)
+                std::memcpy(rgba + ((size_t)y * width + x) * 4, pixels + i * 4, 4);
+        }
+    }
+
+    // picks the closest palette entry for every pixel, comparing channels [firstChannel, firstChannel + channelCount)
+    // against palette[k][0 .. channelCount). Returns the summed squared error.
+    float selectIndices(const Block& block, int firstChannel, int channelCount, const float (*palette)[4], int paletteSize, unsigned char indices[16]) {
+        float total = 0.0f;
+#ifdef BLOCK_COMPRESSION_SSE2
+        for (int group = 0; group < 16; group += 4)
+        {
+            __m128 pixels[4];
+            for (int c = 0; c < channelCount; c++)
+                pixels[c] = _mm_loadu_ps(&block.channels[firstChannel + c][group]);
+
+            __m128 bestError = _mm_set1_ps(FLT_MAX);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int k = 0; k < paletteSize; k++)
+            {
+                __m128 error = _mm_setzero_ps();
+                for (int c = 0; c < channelCount; c++)
+                {
+                    __m128 delta = _mm_sub_ps(pixels[c], _mm_set1_ps(palette[k][c]));
+                    error = _mm_add_ps(error, _mm_mul_ps(delta, delta));
+                }
+                __m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, bestError));
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(k)), _mm_andnot_si128(closer, bestIndex));
+                bestError = _mm_min_ps(error, bestError);
+            }
+
+            int32_t groupIndices[4];
+            float groupErrors[4];
+            _mm_storeu_si128((__m128i*)groupIndices, bestIndex);
+            _mm_storeu_ps(groupErrors, bestError);
+            for (int i = 0; i < 4; i++)
+            {
+                indices[group + i] = (unsigned char)groupIndices[i];
+                total += groupErrors[i];
+            }
+        }
+#else
+        for (int i = 0; i < 16; i++)
+        {
+            float bestError = FLT_MAX;
+            for (int k = 0; k < paletteSize; k++)
+            {
+                float error = 0.0f;
+                for (int c = 0; c < channelCount; c++)
+                {
+                    float delta = block.channels[firstChannel + c][i] - palette[k][c];
+                    error += delta * delta;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    indices[i] = (unsigned char)k;
+                }
+            }
+            total += bestError;
+        }
+#endif
+        return total;
+    }
+
+    // endpoints at the extremes of the pixels projected onto their principal axis, which is found
+    // by power iteration on the covariance matrix
+    void fitEndpoints(const Block& block, int channelCount, float endpoint0[4], float endpoint1[4]) {
+        float mean[4] = {};
+        for (int c = 0; c < channelCount; c++)
+        {
+            for (int i = 0; i < 16; i++)
+                mean[c] += block.channels[c][i];
+            mean[c] /= 16.0f;
+        }
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; i++)
+            for (int a = 0; a < channelCount; a++)
+                for (int b = 0; b < channelCount; b++)
+                    covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+
+        // start from the covariance row of the channel that varies most, it can't be orthogonal to the axis
+        int widest = 0;
+        for (int c = 1; c < channelCount; c++)
+            if (covariance[c][c] > covariance[widest][widest])
+                widest = c;
+        float axis[4] = {};
+        for (int c = 0; c < channelCount; c++)
+            axis[c] = covariance[widest][c];
+
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = {};
+            float largest = 0.0f;
+            for (int a = 0; a < channelCount; a++)
+            {
+                for (int b = 0; b < channelCount; b++)
+                    next[a] += covariance[a][b] * axis[b];
+                largest = std::max(largest, std::fabs(next[a]));
+            }
+            if (largest < 1e-6f)
+                break;
+            for (int c = 0; c < channelCount; c++)
+                axis[c] = next[c] / largest;
+        }
+
+        float length = 0.0f;
+        for (int c = 0; c < channelCount; c++)
+            length += axis[c] * axis[c];
+        length = std::sqrt(length);
+        if (length < 1e-6f)
+        {
+            // flat block
+            for (int c = 0; c < 4; c++)
+                endpoint0[c] = endpoint1[c] = mean[c];
+            return;
+        }
+        for (int c = 0; c < channelCount; c++)
+            axis[c] /= length;
+
+        float low = FLT_MAX, high = -FLT_MAX;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < channelCount; c++)
+                t += (block.channels[c][i] - mean[c]) * axis[c];
+            low = std::min(low, t);
+            high = std::max(high, t);
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            endpoint0[c] = clampChannel(mean[c] + low * axis[c]);
+            endpoint1[c] = clampChannel(mean[c] + high * axis[c]);
+        }
+    }
+
+    // least squares endpoints for fixed per-pixel weights (0 = endpoint0, 1 = endpoint1).
+    // Returns false if the weights don't determine both endpoints.
+    bool refineEndpoints(const Block& block, int channelCount, const float weights[16], float endpoint0[4], float endpoint1[4]) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            float a = 1.0f - weights[i];
+            float b = weights[i];
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channelCount; c++)
+            {
+                ax[c] += a * block.channels[c][i];
+                bx[c] += b * block.channels[c][i];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+            return false;
+        for (int c = 0; c < channelCount; c++)
+        {
+            endpoint0[c] = clampChannel((bb * ax[c] - ab * bx[c]) / determinant);
+            endpoint1[c] = clampChannel((aa * bx[c] - ab * ax[c]) / determinant);
+        }
+        return true;
+    }
+
+    uint16_t packRGB565(const float color[4]) {
+        int r = (int)std::lround(clampChannel(color[0]) * 31.0f / 255.0f);
+        int g = (int)std::lround(clampChannel(color[1]) * 63.0f / 255.0f);
+        int b = (int)std::lround(clampChannel(color[2]) * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    void unpackRGB565(uint16_t packed, float color[4]) {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (float)((r << 3) | (r >> 2));
+        color[1] = (float)((g << 2) | (g >> 4));
+        color[2] = (float)((b << 3) | (b >> 2));
+        color[3] = 255.0f;
+    }
+
+    // quantizes the endpoints, picks the indices and writes the block. Returns its squared error and
+    // the weight of the second stored endpoint for every pixel.
+    float encodeBC1Endpoints(const Block& block, const float endpoint0[4], const float endpoint1[4], unsigned char* out, float weights[16]) {
+        uint16_t color0 = packRGB565(endpoint0);
+        uint16_t color1 = packRGB565(endpoint1);
+        // color0 > color1 selects the opaque 4 color mode
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        float palette[4][4];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        // equal endpoints decode in 3 color mode, where only index 0 is safe to use
+        unsigned char indices[16];
+        float error = selectIndices(block, 0, 3, palette, color0 == color1 ? 1 : 4, indices);
+
+        uint32_t bits = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            bits |= (uint32_t)indices[i] << (2 * i);
+            weights[i] = BC1_WEIGHTS[indices[i]];
+        }
+        out[0] = (unsigned char)(color0 & 0xFF);
+        out[1] = (unsigned char)(color0 >> 8);
+        out[2] = (unsigned char)(color1 & 0xFF);
+        out[3] = (unsigned char)(color1 >> 8);
+        for (int b = 0; b < 4; b++)
+            out[4 + b] = (unsigned char)(bits >> (8 * b));
+        return error;
+    }
+
+    void encodeBC1(const Block& block, unsigned char* out) {
+        float endpoint0[4], endpoint1[4], weights[16];
+        fitEndpoints(block, 3, endpoint0, endpoint1);
+        float bestError = encodeBC1Endpoints(block, endpoint0, endpoint1, out, weights);
+
+        // refit the endpoints to the chosen indices while that keeps lowering the error
+        for (int iteration = 0; iteration < 2 && bestError > 0.0f; iteration++)
+        {
+            unsigned char candidate[8];
+            float candidateWeights[16];
+            if (!refineEndpoints(block, 3, weights, endpoint0, endpoint1))
+                break;
+            float error = encodeBC1Endpoints(block, endpoint0, endpoint1, candidate, candidateWeights);
+            if (error >= bestError)
+                break;
+            bestError = error;
+            std::memcpy(out, candidate, sizeof(candidate));
+            std::memcpy(weights, candidateWeights, sizeof(candidateWeights));
+        }
+    }
+
+    void encodeBC4(const Block& block, int channel, unsigned char* out) {
+        float low = 255.0f, high = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, block.channels[channel][i]);
+            high = std::max(high, block.channels[channel][i]);
+        }
+
+        // value0 > value1 selects the mode with 6 interpolated values
+        int value0 = (int)std::lround(high);
+        int value1 = (int)std::lround(low);
+        unsigned char indices[16] = {};
+        if (value0 > value1)
+        {
+            float palette[8][4];
+            palette[0][0] = (float)value0;
+            palette[1][0] = (float)value1;
+            for (int k = 2; k < 8; k++)
+                palette[k][0] = ((8 - k) * value0 + (k - 1) * value1) / 7.0f;
+            selectIndices(block, channel, 1, palette, 8, indices);
+        }
+
+        uint64_t bits = 0;
+        for (int i = 0; i < 16; i++)
+            bits |= (uint64_t)indices[i] << (3 * i);
+        out[0] = (unsigned char)value0;
+        out[1] = (unsigned char)value1;
+        for (int b = 0; b < 6; b++)
+            out[2 + b] = (unsigned char)(bits >> (8 * b));
+    }
+
+    struct BitWriter {
+        unsigned char* data;
+        int position;
+
+        void write(uint32_t value, int count) {
+            for (int i = 0; i < count; i++, position++)
+                if ((value >> i) & 1)
+                    data[position >> 3] |= (unsigned char)(1 << (position & 7));
+        }
+    };
+
+    struct BitReader {
+        const unsigned char* data;
+        int position;
+
+        uint32_t read(int count) {
+            uint32_t value = 0;
+            for (int i = 0; i < count; i++, position++)
+                value |= (uint32_t)((data[position >> 3] >> (position & 7)) & 1) << i;
+            return value;
+        }
+    };
+
+    // rounds an endpoint to 7 bits per channel plus the p-bit its channels share, trying both p-bits
+    void quantizeBC7Endpoint(const float endpoint[4], int quantized[4], int& pBit) {
+        float bestError = FLT_MAX;
+        for (int p = 0; p < 2; p++)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                candidate[c] = std::min(std::max((int)std::lround((endpoint[c] - p) / 2.0f), 0), 127);
+                float delta = (float)((candidate[c] << 1) | p) - endpoint[c];
+                error += delta * delta;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pBit = p;
+                std::memcpy(quantized, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    // BC7 mode 6: a single subset with 7.7.7.7 endpoints, a p-bit per endpoint and 4 bit indices
+    float encodeBC7Endpoints(const Block& block, const float endpoint0[4], const float endpoint1[4], unsigned char out[16], float weights[16]) {
+        int quantized[2][4];
+        int pBits[2];
+        quantizeBC7Endpoint(endpoint0, quantized[0], pBits[0]);
+        quantizeBC7Endpoint(endpoint1, quantized[1], pBits[1]);
+
+        float palette[16][4];
+        for (int k = 0; k < 16; k++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                int value0 = (quantized[0][c] << 1) | pBits[0];
+                int value1 = (quantized[1][c] << 1) | pBits[1];
+                palette[k][c] = (float)(((64 - BC7_WEIGHTS[k]) * value0 + BC7_WEIGHTS[k] * value1 + 32) >> 6);
+            }
+        }
+
+        unsigned char indices[16];
+        float error = selectIndices(block, 0, 4, palette, 16, indices);
+
+        // the first index is stored without its top bit, so it has to be below 8. The weights are
+        // symmetric, swapping the endpoints and mirroring the indices decodes to the same colors.
+        if (indices[0] & 8)
+        {
+            std::swap(quantized[0], quantized[1]);
+            std::swap(pBits[0], pBits[1]);
+            for (int i = 0; i < 16; i++)
+                indices[i] = (unsigned char)(15 - indices[i]);
+        }
+
+        std::memset(out, 0, 16);
+        BitWriter bits = { out, 0 };
+        bits.write(1 << 6, 7);
+        for (int c = 0; c < 4; c++)
+        {
+            bits.write(quantized[0][c], 7);
+            bits.write(quantized[1][c], 7);
+        }
+        bits.write(pBits[0], 1);
+        bits.write(pBits[1], 1);
+        for (int i = 0; i < 16; i++)
+        {
+            bits.write(indices[i], i == 0 ? 3 : 4);
+            weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+        }
+        return error;
+    }
+
+    void encodeBC7(const Block& block, unsigned char* out) {
+        float endpoint0[4], endpoint1[4], weights[16];
+        fitEndpoints(block, 4, endpoint0, endpoint1);
+        float bestError = encodeBC7Endpoints(block, endpoint0, endpoint1, out, weights);
+
+        for (int iteration = 0; iteration < 2 && bestError > 0.0f; iteration++)
+        {
+            unsigned char candidate[16];
+            float candidateWeights[16];
+            if (!refineEndpoints(block, 4, weights, endpoint0, endpoint1))
+                break;
+            float error = encodeBC7Endpoints(block, endpoint0, endpoint1, candidate, candidateWeights);
+            if (error >= bestError)
+                break;
+            bestError = error;
+            std::memcpy(out, candidate, sizeof(candidate));
+            std::memcpy(weights, candidateWeights, sizeof(candidateWeights));
+        }
+    }
+
+    void encodeBlock(GLenum format, const Block& block, unsigned char* out) {
+        switch (format)
+        {
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            encodeBC1(block, out);
+            break;
+        case GL_COMPRESSED_RED_RGTC1:
+            encodeBC4(block, 0, out);
+            break;
+        case GL_COMPRESSED_RG_RGTC2:
+            encodeBC4(block, 0, out);
+            encodeBC4(block, 1, out + 8);
+            break;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            encodeBC7(block, out);
+            break;
+        }
+    }
+
+    void decodeBC1(const unsigned char* block, unsigned char pixels[64]) {
+        uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+        uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+        float palette[4][4];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 4; c++)
+        {
+            if (color0 > color1)
+            {
+                palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+                palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+            }
+            else
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+                palette[3][c] = 0.0f;
+            }
+        }
+
+        uint32_t bits = (uint32_t)block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 4; c++)
+                pixels[i * 4 + c] = (unsigned char)std::lround(palette[(bits >> (2 * i)) & 3][c]);
+    }
+
+    void decodeBC4(const unsigned char* block, int channel, unsigned char pixels[64]) {
+        int value0 = block[0];
+        int value1 = block[1];
+        float values[8] = { (float)value0, (float)value1 };
+        if (value0 > value1)
+        {
+            for (int k = 2; k < 8; k++)
+                values[k] = ((8 - k) * value0 + (k - 1) * value1) / 7.0f;
+        }
+        else
+        {
+            for (int k = 2; k < 6; k++)
+                values[k] = ((6 - k) * value0 + (k - 1) * value1) / 5.0f;
+            values[6] = 0.0f;
+            values[7] = 255.0f;
+        }
+
+        uint64_t bits = 0;
+        for (int b = 0; b < 6; b++)
+            bits |= (uint64_t)block[2 + b] << (8 * b);
+        for (int i = 0; i < 16; i++)
+            pixels[i * 4 + channel] = (unsigned char)std::lround(values[(bits >> (3 * i)) & 7]);
+    }
+
+    bool decodeBC7(const unsigned char* block, unsigned char pixels[64]) {
+        if ((block[0] & 0x7F) != 0x40)
+            return false;
+
+        BitReader bits = { block, 7 };
+        int endpoints[2][4];
+        for (int c = 0; c < 4; c++)
+        {
+            endpoints[0][c] = (int)bits.read(7) << 1;
+            endpoints[1][c] = (int)bits.read(7) << 1;
+        }
+        int pBit0 = (int)bits.read(1);
+        int pBit1 = (int)bits.read(1);
+        for (int c = 0; c < 4; c++)
+        {
+            endpoints[0][c] |= pBit0;
+            endpoints[1][c] |= pBit1;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int weight = BC7_WEIGHTS[bits.read(i == 0 ? 3 : 4)];
+            for (int c = 0; c < 4; c++)
+                pixels[i * 4 + c] = (unsigned char)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+        }
+        return true;
+    }
+
+    bool decodeBlock(GLenum format, const unsigned char* block, unsigned char pixels[64]) {
+        for (int i = 0; i < 16; i++)
+        {
+            pixels[i * 4 + 0] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = 0;
+            pixels[i * 4 + 3] = 255;
+        }
+
+        switch (format)
+        {
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            decodeBC1(block, pixels);
+            return true;
+        case GL_COMPRESSED_RED_RGTC1:
+            decodeBC4(block, 0, pixels);
+            return true;
+        case GL_COMPRESSED_RG_RGTC2:
+            decodeBC4(block, 0, pixels);
+            decodeBC4(block + 8, 1, pixels);
+            return true;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return decodeBC7(block, pixels);
+        default:
+            return false;
+        }
+    }
+
+}
+
+bool CanCompressFormat(GLenum format) {
+    return CompressedChannelCount(format) > 0;
+}
+
+int CompressedChannelCount(GLenum format) {
+    switch (format)
+    {
+    case GL_COMPRESSED_RED_RGTC1:
+        return 1;
+    case GL_COMPRESSED_RG_RGTC2:
+        return 2;
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        return 3;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+void CompressImage(GLenum format, const unsigned char* rgba, int width, int height, unsigned char* output, ThreadPool& pool) {
+    int blocksWide = (width + 3) / 4;
+    int blocksHigh = (height + 3) / 4;
+    size_t blockBytes = CompressedBlockBytes(format);
+
+    pool.ParallelFor((size_t)blocksHigh, [&](size_t row) {
+        Block block;
+        unsigned char* out = output + row * blocksWide * blockBytes;
+        for (int x = 0; x < blocksWide; x++, out += blockBytes)
+        {
+            loadBlock(rgba, width, height, x, (int)row, block);
+            encodeBlock(format, block, out);
+        }
+    });
+}
+
+bool DecompressImage(GLenum format, const unsigned char* data, int width, int height, unsigned char* rgba) {
+    int blocksWide = (width + 3) / 4;
+    int blocksHigh = (height + 3) / 4;
+    size_t blockBytes = CompressedBlockBytes(format);
+
+    bool valid = true;
+    unsigned char pixels[64];
+    for (int y = 0; y < blocksHigh; y++)
+    {
+        for (int x = 0; x < blocksWide; x++, data += blockBytes)
+        {
+            valid &= decodeBlock(format, data, pixels);
+            storeBlock(pixels, width, height, x, y, rgba);
+        }
+    }
+    return valid;
+}
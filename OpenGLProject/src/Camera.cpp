@@ -1,5 +1,7 @@
 #include <lib/Camera.h>
 
+#include <algorithm>
+
 Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch) 
     : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM) {
     Position = position;
@@ -60,3 +62,8 @@ void Camera::updateCameraVectors() {
 glm::mat4 Camera::GetViewMatrix() {
     return lookAt(Position, Position + Front, Up);
 }
+
+float Camera::PixelsPerUnit(const glm::vec3& point, float viewportHeight) const {
+    float distance = std::max(glm::length(point - Position), 1e-4f);
+    return viewportHeight / (2.0f * distance * tan(glm::radians(Zoom) * 0.5f));
+}
@@ -0,0 +1,342 @@
+#include <lib/CompressedTexture.h>
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+    const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDSD_REQUIRED = 0x1 | 0x2 | 0x4 | 0x1000; // caps, height, width, pixel format
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDSD_LINEARSIZE = 0x80000;
+    const uint32_t DDSCAPS_TEXTURE = 0x1000;
+    const uint32_t DDSCAPS_COMPLEX_MIPMAP = 0x8 | 0x400000;
+    const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+    const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    // DXGI_FORMAT values used by DX10 style DDS headers
+    const uint32_t DXGI_BC1_UNORM = 71;
+    const uint32_t DXGI_BC1_UNORM_SRGB = 72;
+    const uint32_t DXGI_BC3_UNORM = 77;
+    const uint32_t DXGI_BC3_UNORM_SRGB = 78;
+    const uint32_t DXGI_BC4_UNORM = 80;
+    const uint32_t DXGI_BC5_UNORM = 83;
+    const uint32_t DXGI_BC7_UNORM = 98;
+    const uint32_t DXGI_BC7_UNORM_SRGB = 99;
+
+    struct DDSPixelFormat {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t bitMasks[4];
+    };
+
+    struct DDSHeader {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        DDSPixelFormat pixelFormat;
+        uint32_t caps[4];
+        uint32_t reserved2;
+    };
+
+    struct DDSHeaderDX10 {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    struct KTXHeader {
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    uint32_t fourCC(const char* code) {
+        return (uint32_t)(unsigned char)code[0] | ((uint32_t)(unsigned char)code[1] << 8) | ((uint32_t)(unsigned char)code[2] << 16) | ((uint32_t)(unsigned char)code[3] << 24);
+    }
+
+    bool readFile(const std::string& path, std::vector<unsigned char>& bytes) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return !bytes.empty();
+    }
+
+    GLenum formatFromFourCC(uint32_t code) {
+        if (code == fourCC("DXT1"))
+            return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        if (code == fourCC("DXT5"))
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        if (code == fourCC("ATI1") || code == fourCC("BC4U"))
+            return GL_COMPRESSED_RED_RGTC1;
+        if (code == fourCC("ATI2") || code == fourCC("BC5U"))
+            return GL_COMPRESSED_RG_RGTC2;
+        return 0;
+    }
+
+    GLenum formatFromDXGI(uint32_t dxgiFormat) {
+        switch (dxgiFormat)
+        {
+        case DXGI_BC1_UNORM:
+            return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        case DXGI_BC1_UNORM_SRGB:
+            return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+        case DXGI_BC3_UNORM:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case DXGI_BC3_UNORM_SRGB:
+            return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+        case DXGI_BC4_UNORM:
+            return GL_COMPRESSED_RED_RGTC1;
+        case DXGI_BC5_UNORM:
+            return GL_COMPRESSED_RG_RGTC2;
+        case DXGI_BC7_UNORM:
+            return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        case DXGI_BC7_UNORM_SRGB:
+            return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+        default:
+            return 0;
+        }
+    }
+
+    uint32_t dxgiFromFormat(GLenum format) {
+        switch (format)
+        {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            return DXGI_BC1_UNORM;
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+            return DXGI_BC1_UNORM_SRGB;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            return DXGI_BC3_UNORM;
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+            return DXGI_BC3_UNORM_SRGB;
+        case GL_COMPRESSED_RED_RGTC1:
+            return DXGI_BC4_UNORM;
+        case GL_COMPRESSED_RG_RGTC2:
+            return DXGI_BC5_UNORM;
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return DXGI_BC7_UNORM;
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+            return DXGI_BC7_UNORM_SRGB;
+        default:
+            return 0;
+        }
+    }
+
+    // lays out levelCount tightly packed mip levels starting at offset, fails if they don't fit
+    bool buildLevels(CompressedImage& image, unsigned int levelCount, size_t offset) {
+        int width = image.width;
+        int height = image.height;
+        for (unsigned int i = 0; i < levelCount; i++)
+        {
+            size_t size = CompressedLevelBytes(image.format, width, height);
+            if (size > image.data.size() - offset)
+                return false;
+            image.levels.push_back({ width, height, offset, size });
+            offset += size;
+            if (width == 1 && height == 1)
+                break;
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+        return true;
+    }
+
+    bool readDDS(CompressedImage& image) {
+        size_t offset = sizeof(uint32_t) + sizeof(DDSHeader);
+        if (image.data.size() < offset)
+            return false;
+        DDSHeader header;
+        std::memcpy(&header, image.data.data() + sizeof(uint32_t), sizeof(header));
+        if (header.size != sizeof(DDSHeader) || !(header.pixelFormat.flags & DDPF_FOURCC))
+            return false;
+
+        if (header.pixelFormat.fourCC == fourCC("DX10"))
+        {
+            if (image.data.size() < offset + sizeof(DDSHeaderDX10))
+                return false;
+            DDSHeaderDX10 extension;
+            std::memcpy(&extension, image.data.data() + offset, sizeof(extension));
+            offset += sizeof(extension);
+            if (extension.arraySize > 1)
+                return false;
+            image.format = formatFromDXGI(extension.dxgiFormat);
+        }
+        else
+        {
+            image.format = formatFromFourCC(header.pixelFormat.fourCC);
+        }
+
+        image.width = (int)header.width;
+        image.height = (int)header.height;
+        if (image.format == 0 || image.width <= 0 || image.height <= 0)
+            return false;
+        return buildLevels(image, header.mipMapCount > 0 ? header.mipMapCount : 1, offset);
+    }
+
+    bool readKTX(CompressedImage& image) {
+        if (image.data.size() < sizeof(KTXHeader))
+            return false;
+        KTXHeader header;
+        std::memcpy(&header, image.data.data(), sizeof(header));
+        // only native endian, single 2D compressed images
+        if (header.endianness != 0x04030201 || header.glType != 0 || header.pixelDepth > 1
+            || header.numberOfArrayElements > 1 || header.numberOfFaces != 1)
+            return false;
+
+        image.format = header.glInternalFormat;
+        image.width = (int)header.pixelWidth;
+        image.height = (int)header.pixelHeight;
+        if (CompressedBlockBytes(image.format) == 0 || image.width <= 0 || image.height <= 0)
+            return false;
+
+        // every level is prefixed with its size and padded to 4 bytes
+        size_t offset = sizeof(KTXHeader) + header.bytesOfKeyValueData;
+        unsigned int levelCount = header.numberOfMipmapLevels > 0 ? header.numberOfMipmapLevels : 1;
+        int width = image.width;
+        int height = image.height;
+        for (unsigned int i = 0; i < levelCount; i++)
+        {
+            uint32_t imageSize;
+            if (offset > image.data.size() || image.data.size() - offset < sizeof(imageSize))
+                return false;
+            std::memcpy(&imageSize, image.data.data() + offset, sizeof(imageSize));
+            offset += sizeof(imageSize);
+            if (imageSize != CompressedLevelBytes(image.format, width, height) || imageSize > image.data.size() - offset)
+                return false;
+            image.levels.push_back({ width, height, offset, imageSize });
+            offset += (imageSize + 3) & ~(size_t)3;
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+        return true;
+    }
+
+}
+
+size_t CompressedBlockBytes(GLenum format) {
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+size_t CompressedLevelBytes(GLenum format, int width, int height) {
+    size_t blocksWide = (size_t)(width + 3) / 4;
+    size_t blocksHigh = (size_t)(height + 3) / 4;
+    return (blocksWide > 0 ? blocksWide : 1) * (blocksHigh > 0 ? blocksHigh : 1) * CompressedBlockBytes(format);
+}
+
+bool IsCompressedTexturePath(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = path.substr(dot + 1);
+    for (char& c : extension)
+        c = (char)tolower((unsigned char)c);
+    return extension == "dds" || extension == "ktx";
+}
+
+bool ReadCompressedTexture(const std::string& path, CompressedImage& image) {
+    image = CompressedImage();
+    if (!readFile(path, image.data) || image.data.size() < sizeof(KTX_IDENTIFIER))
+        return false;
+
+    bool valid = false;
+    uint32_t magic;
+    std::memcpy(&magic, image.data.data(), sizeof(magic));
+    if (magic == DDS_MAGIC)
+        valid = readDDS(image);
+    else if (std::memcmp(image.data.data(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0)
+        valid = readKTX(image);
+
+    if (!valid)
+        image = CompressedImage();
+    return valid;
+}
+
+bool WriteDDS(const std::string& path, const CompressedImage& image) {
+    uint32_t dxgiFormat = dxgiFromFormat(image.format);
+    if (dxgiFormat == 0 || image.levels.empty())
+        return false;
+
+    DDSHeader header = {};
+    header.size = sizeof(DDSHeader);
+    header.flags = DDSD_REQUIRED | DDSD_LINEARSIZE | (image.levels.size() > 1 ? DDSD_MIPMAPCOUNT : 0);
+    header.height = (uint32_t)image.height;
+    header.width = (uint32_t)image.width;
+    header.pitchOrLinearSize = (uint32_t)image.levels[0].size;
+    header.mipMapCount = (uint32_t)image.levels.size();
+    header.pixelFormat.size = sizeof(DDSPixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    header.pixelFormat.fourCC = fourCC("DX10");
+    header.caps[0] = DDSCAPS_TEXTURE | (image.levels.size() > 1 ? DDSCAPS_COMPLEX_MIPMAP : 0);
+
+    DDSHeaderDX10 extension = {};
+    extension.dxgiFormat = dxgiFormat;
+    extension.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    extension.arraySize = 1;
+
+    // written under a temporary name so a loader never sees a half written file
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)&extension, sizeof(extension));
+        for (const CompressedMipLevel& level : image.levels)
+            out.write((const char*)image.data.data() + level.offset, level.size);
+        if (!out)
+        {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,127 @@
+#include <lib/ContentHash.h>
+
+#include <cstring>
+
+#include <lib/FileUtils.h>
+#include <lib/MappedFile.h>
+
+namespace {
+
+    // xxHash64's primes and round, run on four lanes of 8 bytes each; both output halves mix all four lanes
+    const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    const size_t STRIPE_BYTES = 32;
+
+    uint64_t rotateLeft(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t round(uint64_t lane, uint64_t input) {
+        lane += input * PRIME2;
+        lane = rotateLeft(lane, 31);
+        return lane * PRIME1;
+    }
+
+    // final avalanche so every input bit affects every output bit
+    uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDULL;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    void consumeStripe(uint64_t lanes[4], const unsigned char* stripe) {
+        for (int lane = 0; lane < 4; lane++)
+        {
+            uint64_t input;
+            memcpy(&input, stripe + lane * 8, sizeof(input));
+            lanes[lane] = round(lanes[lane], input);
+        }
+    }
+
+}
+
+bool ContentHash::operator==(const ContentHash& other) const {
+    return low == other.low && high == other.high;
+}
+
+bool ContentHash::operator!=(const ContentHash& other) const {
+    return !(*this == other);
+}
+
+std::string ContentHash::ToHex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(32, '0');
+    for (int i = 0; i < 16; i++)
+    {
+        text[15 - i] = digits[(high >> (i * 4)) & 0xF];
+        text[31 - i] = digits[(low >> (i * 4)) & 0xF];
+    }
+    return text;
+}
+
+bool ContentHash::FromHex(const std::string& text, ContentHash& hash) {
+    if (text.size() != 32)
+        return false;
+    ContentHash parsed;
+    for (int i = 0; i < 32; i++)
+    {
+        char c = text[i];
+        uint64_t digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+            return false;
+        uint64_t& half = i < 16 ? parsed.high : parsed.low;
+        half = (half << 4) | digit;
+    }
+    hash = parsed;
+    return true;
+}
+
+ContentHash HashBytes(const void* data, size_t size, ContentHash seed) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t lanes[4] = { seed.low + PRIME1 + PRIME2, seed.low + PRIME2, seed.high, seed.high - PRIME1 };
+
+    size_t offset = 0;
+    for (; offset + STRIPE_BYTES <= size; offset += STRIPE_BYTES)
+        consumeStripe(lanes, bytes + offset);
+    // the tail is zero padded, mixing in the size keeps "a" and "a\0" apart
+    if (offset < size)
+    {
+        unsigned char tail[STRIPE_BYTES] = {};
+        memcpy(tail, bytes + offset, size - offset);
+        consumeStripe(lanes, tail);
+    }
+
+    ContentHash hash;
+    hash.low = mix(rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18) + (uint64_t)size);
+    hash.high = mix((lanes[0] ^ rotateLeft(lanes[2], 23)) + (lanes[1] ^ rotateLeft(lanes[3], 41)) + (uint64_t)size * PRIME3);
+    return hash;
+}
+
+ContentHash HashString(const std::string& text, ContentHash seed) {
+    return HashBytes(text.data(), text.size(), seed);
+}
+
+bool HashFile(const std::string& path, ContentHash& hash, ContentHash seed) {
+    MappedFile file;
+    if (file.Open(path))
+    {
+        hash = HashBytes(file.Data(), file.Size(), seed);
+        return true;
+    }
+    // empty files can't be mapped
+    FileStamp stamp;
+    if (!GetFileStamp(path, stamp) || stamp.size != 0)
+        return false;
+    hash = HashBytes(nullptr, 0, seed);
+    return true;
+}
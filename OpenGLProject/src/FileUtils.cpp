@@ -0,0 +1,90 @@
+#include <lib/FileUtils.h>
+
+#include <atomic>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <sys/stat.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool GetFileStamp(const std::string& path, FileStamp& stamp) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(path.c_str(), &info) != 0)
+        return false;
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+#endif
+    stamp.modifiedTime = (long long)info.st_mtime;
+    stamp.size = (unsigned long long)info.st_size;
+    return true;
+}
+
+std::string TempPathFor(const std::string& path) {
+    static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+    unsigned long process = GetCurrentProcessId();
+#else
+    unsigned long process = (unsigned long)getpid();
+#endif
+    return path + '.' + std::to_string(process) + '.' + std::to_string(counter++) + ".tmp";
+}
+
+#ifdef _WIN32
+
+bool ListFiles(const std::string& directory, std::vector<std::string>& files) {
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((directory + "/*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+
+    do {
+        std::string name = entry.cFileName;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = directory + '/' + name;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            ListFiles(path, files);
+        else
+            files.push_back(path);
+    } while (FindNextFileA(find, &entry));
+
+    FindClose(find);
+    return true;
+}
+
+#else
+
+bool ListFiles(const std::string& directory, std::vector<std::string>& files) {
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
+        return false;
+
+    while (dirent* entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = directory + '/' + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            continue;
+        if (S_ISDIR(info.st_mode))
+            ListFiles(path, files);
+        else if (S_ISREG(info.st_mode))
+            files.push_back(path);
+    }
+
+    closedir(dir);
+    return true;
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include <lib/FileWatcher.h>
+
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <lib/TextureRegistry.h>
+
+namespace {
+
+    // how long the watch thread waits for events (or between polls) before checking whether it should stop
+    const int WAKE_MILLISECONDS = 100;
+#ifndef __linux__
+    // a few polls per second are plenty for hand edits and cost next to nothing for a few hundred files
+    const int POLL_INTERVAL = 3;
+#endif
+
+    double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+#ifndef __linux__
+    // a missing file has no stamp, which counts as one more state it can change from or to
+    FileStamp stampOf(const std::string& path) {
+        FileStamp stamp;
+        if (!GetFileStamp(path, stamp))
+        {
+            stamp.modifiedTime = -1;
+            stamp.size = 0;
+        }
+        return stamp;
+    }
+#endif
+
+}
+
+FileWatcher::FileWatcher(double settleSeconds) : m_settleSeconds(settleSeconds), m_running(true) {
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0)
+        std::cout << "WARNING::FILE_WATCHER:: inotify is not available, file changes won't be noticed" << std::endl;
+#endif
+    m_thread = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher() {
+    m_running = false;
+    m_thread.join();
+#ifdef __linux__
+    if (m_inotify >= 0)
+        close(m_inotify);
+#endif
+}
+
+bool FileWatcher::Watch(const std::string& path) {
+    std::string file = TextureRegistry::CanonicalPath(path);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_files.insert(file).second)
+        return true;
+
+#ifdef __linux__
+    // the directory is watched rather than the file, whose inode changes when an editor saves through a rename
+    size_t slash = file.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : file.substr(0, slash);
+    if (m_watches.count(directory))
+        return true;
+    int watch = m_inotify < 0 ? -1 : inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+    if (watch < 0)
+    {
+        std::cout << "WARNING::FILE_WATCHER:: Can't watch " << directory << std::endl;
+        m_files.erase(file);
+        return false;
+    }
+    m_watches[directory] = watch;
+    m_directories[watch] = directory;
+#else
+    m_stamps[file] = stampOf(file);
+#endif
+    return true;
+}
+
+std::vector<std::string> FileWatcher::TakeChanges() {
+    std::vector<std::string> changes;
+    double settled = now() - m_settleSeconds;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto pending = m_pending.begin(); pending != m_pending.end();)
+    {
+        if (pending->second <= settled)
+        {
+            changes.push_back(pending->first);
+            pending = m_pending.erase(pending);
+        }
+        else
+        {
+            ++pending;
+        }
+    }
+    return changes;
+}
+
+void FileWatcher::changed(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_files.count(path))
+        m_pending[path] = now();
+}
+
+#ifdef __linux__
+void FileWatcher::run() {
+    // aligned for the inotify_event headers it holds
+    alignas(inotify_event) char buffer[4096];
+    while (m_running)
+    {
+        pollfd descriptor = { m_inotify, POLLIN, 0 };
+        if (m_inotify < 0 || poll(&descriptor, 1, WAKE_MILLISECONDS) <= 0)
+        {
+            if (m_inotify < 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(WAKE_MILLISECONDS));
+            continue;
+        }
+
+        ssize_t length;
+        while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+        {
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const inotify_event* event = (const inotify_event*)(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->len == 0)
+                    continue;
+
+                std::string directory;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    auto found = m_directories.find(event->wd);
+                    if (found == m_directories.end())
+                        continue;
+                    directory = found->second;
+                }
+                changed(directory + '/' + event->name);
+            }
+        }
+    }
+}
+#else
+void FileWatcher::run() {
+    int wakes = 0;
+    while (m_running)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WAKE_MILLISECONDS));
+        if (++wakes < POLL_INTERVAL)
+            continue;
+        wakes = 0;
+
+        std::vector<std::string> files;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            files.assign(m_files.begin(), m_files.end());
+        }
+        // stat outside the lock, Watch and TakeChanges shouldn't wait for the file system
+        for (const std::string& file : files)
+        {
+            FileStamp stamp = stampOf(file);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            FileStamp& known = m_stamps[file];
+            if (stamp.modifiedTime != known.modifiedTime || stamp.size != known.size)
+            {
+                known = stamp;
+                m_pending[file] = now();
+            }
+        }
+    }
+}
+#endif
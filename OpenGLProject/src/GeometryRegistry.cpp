@@ -0,0 +1,59 @@
+#include <lib/GeometryRegistry.h>
+
+GeometryRegistry::GeometryRegistry() {
+    m_stats.hits = 0;
+    m_stats.misses = 0;
+    m_stats.geometries = 0;
+    m_stats.residentBytes = 0;
+    m_stats.reusedBytes = 0;
+}
+
+GeometryRegistry& GeometryRegistry::Instance() {
+    static GeometryRegistry registry;
+    return registry;
+}
+
+const GeometryRegistry::Buffers* GeometryRegistry::Acquire(const ContentHash& hash) {
+    std::unordered_map<ContentHash, unsigned int>::iterator found = m_vaosByHash.find(hash);
+    if (found == m_vaosByHash.end())
+    {
+        m_stats.misses++;
+        return nullptr;
+    }
+
+    Entry& entry = m_entries[found->second];
+    entry.refCount++;
+    m_stats.hits++;
+    m_stats.reusedBytes += entry.buffers.vertexBufferBytes + entry.buffers.indexBufferBytes;
+    return &entry.buffers;
+}
+
+void GeometryRegistry::Add(const ContentHash& hash, const Buffers& buffers) {
+    Entry entry;
+    entry.hash = hash;
+    entry.refCount = 1;
+    entry.buffers = buffers;
+    m_entries[buffers.VAO] = entry;
+    m_vaosByHash[hash] = buffers.VAO;
+    m_stats.geometries++;
+    m_stats.residentBytes += buffers.vertexBufferBytes + buffers.indexBufferBytes;
+}
+
+void GeometryRegistry::Release(unsigned int vao) {
+    std::unordered_map<unsigned int, Entry>::iterator found = m_entries.find(vao);
+    if (found == m_entries.end() || --found->second.refCount > 0)
+        return;
+
+    Buffers& buffers = found->second.buffers;
+    glDeleteVertexArrays(1, &buffers.VAO);
+    glDeleteBuffers(1, &buffers.VBO);
+    glDeleteBuffers(1, &buffers.EBO);
+    m_stats.geometries--;
+    m_stats.residentBytes -= buffers.vertexBufferBytes + buffers.indexBufferBytes;
+    m_vaosByHash.erase(found->second.hash);
+    m_entries.erase(found);
+}
+
+GeometryRegistry::Stats GeometryRegistry::GetStats() const {
+    return m_stats;
+}
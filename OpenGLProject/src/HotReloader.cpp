@@ -0,0 +1,157 @@
+#include <lib/HotReloader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+#include <lib/ThreadPool.h>
+#include <lib/VirtualTextureCache.h>
+
+namespace {
+
+    double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+}
+
+struct HotReloader::TextureReload {
+    string path;
+    DecodedImage image;
+    std::atomic<bool> decoded;
+
+    TextureReload() : decoded(false) {}
+};
+
+void HotReloader::Track(const std::shared_ptr<Model>& model, const string& path) {
+    TrackedModel tracked;
+    tracked.model = model;
+    tracked.path = path;
+    tracked.dependencies.insert(TextureRegistry::CanonicalPath(path));
+    tracked.watching = false;
+    m_models.push_back(tracked);
+    m_watcher.Watch(path);
+}
+
+void HotReloader::Update(double budgetSeconds) {
+    double start = now();
+
+    // 1. start reloading whatever changed: a model when one of its files did, otherwise the texture
+    for (const string& path : m_watcher.TakeChanges())
+    {
+        bool modelFile = false;
+        for (TrackedModel& tracked : m_models)
+        {
+            std::shared_ptr<Model> model = tracked.model.lock();
+            if (!model || !tracked.dependencies.count(path))
+                continue;
+            // a reload still in flight is dropped, the new one reads the latest files
+            std::cout << "Reloading " << tracked.path << std::endl;
+            tracked.replacement = m_streamer.Reload(*model, tracked.path);
+            modelFile = true;
+        }
+        if (modelFile)
+            continue;
+        if (!TextureRegistry::Instance().Usages(path).empty())
+            reloadTexture(path);
+        // paged textures aren't in the registry, the cache decodes them again itself
+        if (VirtualTextureCache::Instance().Reload(path))
+            std::cout << "Reloading texture " << path << std::endl;
+    }
+
+    // 2. upload the reloaded models within the budget, then swap each finished one in
+    m_streamer.Update(std::max(budgetSeconds - (now() - start), 0.0));
+    for (size_t i = 0; i < m_models.size();)
+    {
+        TrackedModel& tracked = m_models[i];
+        std::shared_ptr<Model> model = tracked.model.lock();
+        if (!model)
+        {
+            m_models.erase(m_models.begin() + i);
+            continue;
+        }
+
+        if (tracked.replacement && tracked.replacement->IsReady())
+        {
+            model->swapContents(*tracked.replacement);
+            // deletes the old meshes and drops the references on the old textures
+            tracked.replacement.reset();
+            tracked.watching = false;
+            std::cout << "Reloaded " << tracked.path << std::endl;
+        }
+        if (!tracked.watching && model->IsReady())
+            watchFiles(tracked, *model);
+        i++;
+    }
+
+    // 3. put decoded textures in place of the old ones: into the same layer while the layout stays and no other file
+    // shares it, otherwise into an array of their own, which models pick up when they draw next
+    for (size_t i = 0; i < m_textures.size();)
+    {
+        TextureReload& reload = *m_textures[i];
+        if (!reload.decoded)
+        {
+            i++;
+            continue;
+        }
+
+        // the file is loaded once per usage
+        TextureRegistry& registry = TextureRegistry::Instance();
+        const ContentHash* content = reload.image.hashed ? &reload.image.content : nullptr;
+        if (!reload.image.IsDecoded())
+        {
+            std::cout << "Texture failed to load at path: " << reload.path << std::endl;
+        }
+        else
+        {
+            for (const string& usage : registry.Usages(reload.path))
+            {
+                TextureSource source = { reload.path, usage };
+                TextureSlot slot = registry.Find(source);
+                const TextureLayout* layout = registry.Layout(slot.id);
+                if (!layout)
+                    continue;
+                // files with the same old contents share the layer, they keep it
+                if (*layout == LayoutOf(reload.image) && !registry.IsShared(source))
+                {
+                    UploadTextureLayer(slot.id, slot.layer, reload.image);
+                    registry.Rehash(source, content);
+                }
+                else
+                {
+                    unsigned int newID;
+                    glGenTextures(1, &newID);
+                    registry.MoveTexture(source, newID, LayoutOf(reload.image), content);
+                    UploadTextureArray(newID, { &reload.image });
+                }
+                std::cout << "Reloaded texture " << reload.path << " (" << usage << ")" << std::endl;
+            }
+        }
+        FreeImage(reload.image);
+        m_textures.erase(m_textures.begin() + i);
+    }
+}
+
+void HotReloader::watchFiles(TrackedModel& tracked, const Model& model) {
+    tracked.dependencies.clear();
+    tracked.dependencies.insert(TextureRegistry::CanonicalPath(tracked.path));
+    for (const string& file : model.sourceFiles)
+        tracked.dependencies.insert(TextureRegistry::CanonicalPath(file));
+
+    for (const string& file : tracked.dependencies)
+        m_watcher.Watch(file);
+    for (const Texture& texture : model.textures_loaded)
+        m_watcher.Watch(model.directory + '/' + texture.path);
+    tracked.watching = true;
+}
+
+void HotReloader::reloadTexture(const string& path) {
+    std::shared_ptr<TextureReload> reload = std::make_shared<TextureReload>();
+    reload->path = path;
+    m_textures.push_back(reload);
+    ThreadPool::Shared().Submit([reload] {
+        DecodeAndHashImage(reload->path, reload->image, false);
+        reload->decoded = true;
+    });
+}
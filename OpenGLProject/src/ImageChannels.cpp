@@ -0,0 +1,179 @@
+#include <lib/ImageChannels.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_CHANNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    // pixels scanned between checks whether any channel can still be dropped, so a colour image with alpha is
+    // rejected after its first rows instead of being read whole
+    const size_t CHUNK_PIXELS = 4096;
+
+    // what a scan found so far: the smallest and largest value of every channel, and for a pixel compared with
+    // itself shifted down by 1, 2 and 3 channels (r with g, b and a, g with b and a, b with a) every bit that
+    // ever differed, one byte per channel
+    struct ChannelStats {
+        uint8_t minimum[4];
+        uint8_t maximum[4];
+        uint32_t differences[3];
+    };
+
+    ChannelStats initialStats() {
+        ChannelStats stats;
+        for (int c = 0; c < 4; c++)
+        {
+            stats.minimum[c] = 255;
+            stats.maximum[c] = 0;
+        }
+        for (int shift = 0; shift < 3; shift++)
+            stats.differences[shift] = 0;
+        return stats;
+    }
+
+    void scanScalar(const unsigned char* rgba, size_t pixelCount, ChannelStats& stats) {
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            const unsigned char* pixel = rgba + i * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                stats.minimum[c] = std::min(stats.minimum[c], pixel[c]);
+                stats.maximum[c] = std::max(stats.maximum[c], pixel[c]);
+            }
+            uint32_t value = pixel[0] | (uint32_t)pixel[1] << 8 | (uint32_t)pixel[2] << 16 | (uint32_t)pixel[3] << 24;
+            stats.differences[0] |= value ^ (value >> 8);
+            stats.differences[1] |= value ^ (value >> 16);
+            stats.differences[2] |= value ^ (value >> 24);
+        }
+    }
+
+    void scan(const unsigned char* rgba, size_t pixelCount, ChannelStats& stats) {
+        size_t i = 0;
+#ifdef IMAGE_CHANNELS_SSE2
+        // four pixels at a time; every 32 bit lane is one pixel with r in its lowest byte
+        __m128i minimum = _mm_set1_epi8((char)0xFF);
+        __m128i maximum = _mm_setzero_si128();
+        __m128i differences1 = _mm_setzero_si128();
+        __m128i differences2 = _mm_setzero_si128();
+        __m128i differences3 = _mm_setzero_si128();
+        for (; i + 4 <= pixelCount; i += 4)
+        {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+            minimum = _mm_min_epu8(minimum, pixels);
+            maximum = _mm_max_epu8(maximum, pixels);
+            differences1 = _mm_or_si128(differences1, _mm_xor_si128(pixels, _mm_srli_epi32(pixels, 8)));
+            differences2 = _mm_or_si128(differences2, _mm_xor_si128(pixels, _mm_srli_epi32(pixels, 16)));
+            differences3 = _mm_or_si128(differences3, _mm_xor_si128(pixels, _mm_srli_epi32(pixels, 24)));
+        }
+
+        uint8_t minima[16], maxima[16];
+        uint32_t lanes[3][4];
+        _mm_storeu_si128((__m128i*)minima, minimum);
+        _mm_storeu_si128((__m128i*)maxima, maximum);
+        _mm_storeu_si128((__m128i*)lanes[0], differences1);
+        _mm_storeu_si128((__m128i*)lanes[1], differences2);
+        _mm_storeu_si128((__m128i*)lanes[2], differences3);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                stats.minimum[c] = std::min(stats.minimum[c], minima[lane * 4 + c]);
+                stats.maximum[c] = std::max(stats.maximum[c], maxima[lane * 4 + c]);
+            }
+            for (int shift = 0; shift < 3; shift++)
+                stats.differences[shift] |= lanes[shift][lane];
+        }
+#endif
+        scanScalar(rgba + i * 4, pixelCount - i, stats);
+    }
+
+    // whether channel second always equals channel first, first < second
+    bool channelsEqual(const ChannelStats& stats, int first, int second) {
+        return ((stats.differences[second - first - 1] >> (first * 8)) & 0xFF) == 0;
+    }
+
+    ChannelLayout layoutFor(const ChannelStats& stats) {
+        ChannelLayout layout;
+        layout.count = 0;
+        for (int c = 0; c < 4; c++)
+        {
+            // red is always stored, the texture needs at least one channel
+            bool constant = c > 0 && stats.minimum[c] == stats.maximum[c];
+            if (constant && stats.minimum[c] == 0)
+            {
+                layout.swizzle[c] = CHANNEL_ZERO;
+                continue;
+            }
+            if (constant && stats.minimum[c] == 255)
+            {
+                layout.swizzle[c] = CHANNEL_ONE;
+                continue;
+            }
+
+            int duplicate = -1;
+            for (int stored = 0; stored < layout.count && duplicate < 0; stored++)
+                if (channelsEqual(stats, layout.sources[stored], c))
+                    duplicate = stored;
+            if (duplicate >= 0)
+            {
+                layout.swizzle[c] = (unsigned char)duplicate;
+                continue;
+            }
+
+            layout.sources[layout.count] = (unsigned char)c;
+            layout.swizzle[c] = (unsigned char)layout.count;
+            layout.count++;
+        }
+        for (int stored = layout.count; stored < 4; stored++)
+            layout.sources[stored] = 0;
+        return layout;
+    }
+
+}
+
+bool ChannelLayout::operator==(const ChannelLayout& other) const {
+    if (count != other.count)
+        return false;
+    for (int c = 0; c < 4; c++)
+        if (sources[c] != other.sources[c] || swizzle[c] != other.swizzle[c])
+            return false;
+    return true;
+}
+
+ChannelLayout AnalyzeChannels(const unsigned char* rgba, size_t pixelCount) {
+    ChannelStats stats = initialStats();
+    for (size_t start = 0; start < pixelCount; start += CHUNK_PIXELS)
+    {
+        scan(rgba + start * 4, std::min(CHUNK_PIXELS, pixelCount - start), stats);
+        // the stats only ever lose reductions, once every channel is needed the rest can't change that
+        if (layoutFor(stats).count == 4)
+            return ChannelLayout();
+    }
+    return layoutFor(stats);
+}
+
+void PackChannels(const unsigned char* rgba, size_t pixelCount, const ChannelLayout& layout, unsigned char* out) {
+    for (size_t i = 0; i < pixelCount; i++)
+        for (int stored = 0; stored < layout.count; stored++)
+            out[i * layout.count + stored] = rgba[i * 4 + layout.sources[stored]];
+}
+
+void ExpandChannels(const unsigned char* packed, size_t pixelCount, const ChannelLayout& layout, unsigned char* rgba) {
+    // four stored channels are always r, g, b and a in order
+    if (layout.count == 4)
+    {
+        std::memcpy(rgba, packed, pixelCount * 4);
+        return;
+    }
+    for (size_t i = 0; i < pixelCount; i++)
+        for (int c = 0; c < 4; c++)
+        {
+            unsigned char source = layout.swizzle[c];
+            rgba[i * 4 + c] = source == CHANNEL_ZERO ? 0 : source == CHANNEL_ONE ? 255 : packed[i * layout.count + source];
+        }
+}
@@ -0,0 +1,42 @@
+#include <lib/ImportProfile.h>
+
+#include <assimp/postprocess.h>
+
+unsigned int ImportFlagsFor(ImportProfile profile) {
+    switch (profile)
+    {
+    case IMPORT_PROFILE_FAST_PREVIEW:
+        return aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_FlipUVs;
+    case IMPORT_PROFILE_FULL_QUALITY:
+        return aiProcess_ValidateDataStructure | aiProcess_FindInvalidData | aiProcess_Triangulate | aiProcess_GenSmoothNormals
+            | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    case IMPORT_PROFILE_RUNTIME:
+    default:
+        return aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs;
+    }
+}
+
+const char* ImportProfileName(ImportProfile profile) {
+    switch (profile)
+    {
+    case IMPORT_PROFILE_FAST_PREVIEW:
+        return "fast-preview";
+    case IMPORT_PROFILE_FULL_QUALITY:
+        return "full-quality";
+    case IMPORT_PROFILE_RUNTIME:
+    default:
+        return "runtime";
+    }
+}
+
+bool ParseImportProfile(const std::string& name, ImportProfile& profile) {
+    for (int i = 0; i < IMPORT_PROFILE_COUNT; i++)
+    {
+        if (name == ImportProfileName((ImportProfile)i))
+        {
+            profile = (ImportProfile)i;
+            return true;
+        }
+    }
+    return false;
+}
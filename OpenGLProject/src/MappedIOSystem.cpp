@@ -0,0 +1,102 @@
+#include <lib/MappedIOSystem.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <lib/FileUtils.h>
+
+MappedIOStream::MappedIOStream() : m_position(0) {}
+
+bool MappedIOStream::Open(const std::string& path) {
+    m_position = 0;
+    if (m_file.Open(path))
+        return true;
+    // an empty file can't be mapped but still opens, as a stream with nothing to read
+    FileStamp stamp;
+    return GetFileStamp(path, stamp) && stamp.size == 0;
+}
+
+size_t MappedIOStream::Read(void* buffer, size_t size, size_t count) {
+    if (size == 0)
+        return 0;
+    // whole elements only, like fread
+    size_t elements = std::min(count, (m_file.Size() - m_position) / size);
+    if (elements == 0)
+        return 0;
+    memcpy(buffer, m_file.Data() + m_position, elements * size);
+    m_position += elements * size;
+    return elements;
+}
+
+size_t MappedIOStream::Write(const void*, size_t, size_t) {
+    return 0;
+}
+
+aiReturn MappedIOStream::Seek(size_t offset, aiOrigin origin) {
+    // offsets from the current position or the end may be negative, wrapped around as size_t
+    size_t position = offset;
+    if (origin == aiOrigin_CUR)
+        position = m_position + offset;
+    else if (origin == aiOrigin_END)
+        position = m_file.Size() + offset;
+    if (position > m_file.Size())
+        return aiReturn_FAILURE;
+    m_position = position;
+    return aiReturn_SUCCESS;
+}
+
+size_t MappedIOStream::Tell() const {
+    return m_position;
+}
+
+size_t MappedIOStream::FileSize() const {
+    return m_file.Size();
+}
+
+void MappedIOStream::Flush() {
+}
+
+const unsigned char* MappedIOStream::Data() const {
+    return m_file.Data();
+}
+
+bool MappedIOSystem::Exists(const char* path) const {
+    FileStamp stamp;
+    return GetFileStamp(path, stamp);
+}
+
+char MappedIOSystem::getOsSeparator() const {
+#ifdef _WIN32
+    return '\\';
+#else
+    return '/';
+#endif
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* path, const char* mode) {
+    if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+    {
+        std::cout << "ERROR::MAPPED_IO:: Can't open " << path << " for writing" << std::endl;
+        return nullptr;
+    }
+
+    // importers probe for optional files, so a missing one isn't worth a message
+    MappedIOStream* stream = new MappedIOStream();
+    if (!stream->Open(path))
+    {
+        delete stream;
+        return nullptr;
+    }
+    if (std::find(m_openedPaths.begin(), m_openedPaths.end(), path) == m_openedPaths.end())
+        m_openedPaths.push_back(path);
+    return stream;
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* stream) {
+    delete stream;
+}
+
+const std::vector<std::string>& MappedIOSystem::OpenedPaths() const {
+    return m_openedPaths;
+}
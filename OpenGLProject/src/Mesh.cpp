@@ -1,85 +1,716 @@
 #include <lib/Mesh.h>
+#include <lib/GeometryRegistry.h>
+#include <lib/Meshlet.h>
+#include <lib/VirtualTextureCache.h>
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <glm/gtc/packing.hpp>
+
+namespace {
+
+    // half floats resolve [-1, 1] to 1/2048 or better, uvs that tile further out keep the float layout
+    const float MAX_HALF_TEXCOORD = 1.0f;
+    // a split mesh may take at most this many times the draw calls a perfect split would need
+    const size_t MAX_INDEX_RANGE_FACTOR = 2;
+    const size_t MAX_SHORT_INDEX_SPAN = 65536;
+
+    // largest position error (object space units) 16 bit quantization may introduce
+    const float MAX_QUANTIZATION_ERROR = 0.0005f;
+
+    // texture units of each material texture type: diffuse 0-2, specular 3-5, normal 6-8, height 9-11, then the page
+    // table of a virtual texture_diffuse1 and the virtual texture atlas
+    const GLint MATERIAL_UNITS_PER_TYPE = 3;
+    const GLint VIRTUAL_PAGE_TABLE_UNIT = 4 * MATERIAL_UNITS_PER_TYPE;
+    const GLint VIRTUAL_ATLAS_UNIT = VIRTUAL_PAGE_TABLE_UNIT + 1;
+    // texture bound to each of them by bindMaterial plus one, 0 if unknown
+    unsigned int boundMaterialTextures[VIRTUAL_ATLAS_UNIT + 1] = {};
+
+    void bindMaterialTexture(GLint unit, GLenum target, unsigned int texture) {
+        if (boundMaterialTextures[unit] == texture + 1)
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        boundMaterialTextures[unit] = texture + 1;
+    }
+
+    // 1x1 mid grey array drawn in place of textures that aren't uploaded yet or failed to load, made on first use
+    unsigned int placeholderTexture = 0;
+
+    unsigned int placeholder() {
+        if (placeholderTexture != 0)
+            return placeholderTexture;
+        const unsigned char grey[4] = { 128, 128, 128, 255 };
+        glGenTextures(1, &placeholderTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, placeholderTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        // it went to whatever unit was active
+        for (unsigned int& texture : boundMaterialTextures)
+            texture = 0;
+        return placeholderTexture;
+    }
+
+    int16_t toSnorm16(float value) {
+        return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+    }
+
+    int8_t toSnorm8(float value) {
+        return (int8_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 127.0f);
+    }
+
+    // maps a unit vector onto the octahedron and unfolds it into [-1, 1]^2
+    glm::vec2 encodeOctahedral(const glm::vec3& v) {
+        float length = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+        if (!(length > 1e-20f))
+            return glm::vec2(0.0f);
+        glm::vec2 e = glm::vec2(v.x, v.y) / length;
+        if (v.z < 0.0f)
+        {
+            e = glm::vec2((1.0f - std::fabs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+                          (1.0f - std::fabs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return e;
+    }
+
+    // everything but the position, which PackedVertex and QuantizedVertex store differently
+    template <typename PackedType>
+    void packAttributes(const Vertex& vertex, PackedType& packed) {
+        glm::vec2 normal = encodeOctahedral(vertex.Normal);
+        packed.Normal[0] = toSnorm16(normal.x);
+        packed.Normal[1] = toSnorm16(normal.y);
+
+        glm::uint32 texCoords = glm::packHalf2x16(vertex.TexCoords);
+        packed.TexCoords[0] = (uint16_t)(texCoords & 0xFFFF);
+        packed.TexCoords[1] = (uint16_t)(texCoords >> 16);
+
+        glm::vec2 tangent = encodeOctahedral(vertex.Tangent);
+        bool rightHanded = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) >= 0.0f;
+        packed.Tangent[0] = toSnorm8(tangent.x);
+        packed.Tangent[1] = toSnorm8(tangent.y);
+        packed.Tangent[2] = rightHanded ? 127 : -127;
+        packed.Tangent[3] = 0;
+    }
+
+    // allocates the bound buffer and has convert write its count elements straight into the mapped storage. Where
+    // mapping fails, or the contents are lost on unmap, they go through a temporary copy instead.
+    template <typename Element, typename Convert>
+    void uploadConverted(GLenum target, size_t count, Convert convert) {
+        GLsizeiptr size = (GLsizeiptr)(count * sizeof(Element));
+        glBufferData(target, size, nullptr, GL_STATIC_DRAW);
+        if (count == 0)
+            return;
+
+        Element* mapped = (Element*)glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            convert(mapped);
+            if (glUnmapBuffer(target) == GL_TRUE)
+                return;
+            cout << "WARNING::MESH:: Mapped buffer contents were lost, uploading again" << endl;
+        }
+
+        vector<Element> staging(count);
+        convert(staging.data());
+        glBufferSubData(target, 0, size, staging.data());
+    }
+
+    // how a stream is stored in each vertex format: where it sits in the format's full vertex (Vertex, PackedVertex or
+    // QuantizedVertex) and how the vertex shader reads it; size 0 where the format has no such stream
+    struct StreamFormat {
+        size_t offset;
+        size_t size;
+        GLint components;
+        GLenum type;
+        GLboolean normalized;
+    };
+
+    const StreamFormat STREAM_FORMATS[3][VERTEX_STREAM_COUNT] = {
+        // VERTEX_FORMAT_FLOAT
+        {
+            { offsetof(Vertex, Position), sizeof(glm::vec3), 3, GL_FLOAT, GL_FALSE },
+            { offsetof(Vertex, Normal), sizeof(glm::vec3), 3, GL_FLOAT, GL_FALSE },
+            { offsetof(Vertex, TexCoords), sizeof(glm::vec2), 2, GL_FLOAT, GL_FALSE },
+            { offsetof(Vertex, Tangent), sizeof(glm::vec3), 3, GL_FLOAT, GL_FALSE },
+            { offsetof(Vertex, Bitangent), sizeof(glm::vec3), 3, GL_FLOAT, GL_FALSE }
+        },
+        // VERTEX_FORMAT_PACKED: octahedral normal, half float uvs, octahedral tangent with its handedness
+        {
+            { offsetof(PackedVertex, Position), sizeof(PackedVertex::Position), 3, GL_FLOAT, GL_FALSE },
+            { offsetof(PackedVertex, Normal), sizeof(PackedVertex::Normal), 2, GL_SHORT, GL_TRUE },
+            { offsetof(PackedVertex, TexCoords), sizeof(PackedVertex::TexCoords), 2, GL_HALF_FLOAT, GL_FALSE },
+            { offsetof(PackedVertex, Tangent), sizeof(PackedVertex::Tangent), 3, GL_BYTE, GL_TRUE },
+            { 0, 0, 0, 0, GL_FALSE }
+        },
+        // VERTEX_FORMAT_QUANTIZED: the same with snorm16 positions, padded to 8 bytes
+        {
+            { offsetof(QuantizedVertex, Position), sizeof(QuantizedVertex::Position), 3, GL_SHORT, GL_TRUE },
+            { offsetof(QuantizedVertex, Normal), sizeof(QuantizedVertex::Normal), 2, GL_SHORT, GL_TRUE },
+            { offsetof(QuantizedVertex, TexCoords), sizeof(QuantizedVertex::TexCoords), 2, GL_HALF_FLOAT, GL_FALSE },
+            { offsetof(QuantizedVertex, Tangent), sizeof(QuantizedVertex::Tangent), 3, GL_BYTE, GL_TRUE },
+            { 0, 0, 0, 0, GL_FALSE }
+        }
+    };
+
+    // a vertex of the buffer: where each stream sits in it, -1 for the streams it doesn't hold, and its size
+    struct StreamLayout {
+        int offsets[VERTEX_STREAM_COUNT];
+        GLsizei stride;
+    };
+
+    StreamLayout streamLayout(VertexFormat format, VertexStreams streams) {
+        StreamLayout layout;
+        layout.stride = 0;
+        for (int stream = 0; stream < VERTEX_STREAM_COUNT; stream++)
+        {
+            const StreamFormat& streamFormat = STREAM_FORMATS[format][stream];
+            bool stored = (streams & (1u << stream)) != 0 && streamFormat.size > 0;
+            layout.offsets[stream] = stored ? (int)layout.stride : -1;
+            if (stored)
+                layout.stride += (GLsizei)streamFormat.size;
+        }
+        return layout;
+    }
+
+    // has encode build the format's full vertex of every vertex and writes the layout's streams of it into the bound
+    // array buffer
+    template <typename FullVertex, typename Encode>
+    void uploadStreams(VertexFormat format, const StreamLayout& layout, size_t vertexCount, Encode encode) {
+        uploadConverted<unsigned char>(GL_ARRAY_BUFFER, vertexCount * layout.stride, [&](unsigned char* out) {
+            FullVertex full;
+            for (size_t i = 0; i < vertexCount; i++, out += layout.stride)
+            {
+                encode(i, full);
+                for (int stream = 0; stream < VERTEX_STREAM_COUNT; stream++)
+                {
+                    if (layout.offsets[stream] < 0)
+                        continue;
+                    const StreamFormat& streamFormat = STREAM_FORMATS[format][stream];
+                    std::memcpy(out + layout.offsets[stream], (const unsigned char*)&full + streamFormat.offset, streamFormat.size);
+                }
+            }
+        });
+    }
+
+    void setAttributePointers(VertexFormat format, const StreamLayout& layout) {
+        for (int stream = 0; stream < VERTEX_STREAM_COUNT; stream++)
+        {
+            // a shader reading a missing stream gets the attribute's current value instead
+            if (layout.offsets[stream] < 0)
+            {
+                glDisableVertexAttribArray(stream);
+                continue;
+            }
+            const StreamFormat& streamFormat = STREAM_FORMATS[format][stream];
+            glEnableVertexAttribArray(stream);
+            glVertexAttribPointer(stream, streamFormat.components, streamFormat.type, streamFormat.normalized, layout.stride,
+                (void*)(size_t)layout.offsets[stream]);
+        }
+    }
+
+}
+
+VertexStreams VertexStreamsFor(const Shader& shader) {
+    VertexStreams streams = VERTEX_STREAM_POSITION;
+    for (GLint location : shader.GetActiveAttributeLocations())
+        if (location < VERTEX_STREAM_COUNT)
+            streams |= 1u << location;
+    return streams;
+}
+
+VertexFormat ChooseVertexFormat(const Vertex* vertices, size_t vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        if (std::fabs(vertices[i].TexCoords.x) > MAX_HALF_TEXCOORD || std::fabs(vertices[i].TexCoords.y) > MAX_HALF_TEXCOORD)
+            return VERTEX_FORMAT_FLOAT;
+    }
+
+    // snorm16 splits the bounds into 65534 steps, rounding is off by half a step at most
+    glm::vec3 extent = boundsMax - boundsMin;
+    float largestError = std::max(extent.x, std::max(extent.y, extent.z)) / 65534.0f / 2.0f;
+    return largestError <= MAX_QUANTIZATION_ERROR ? VERTEX_FORMAT_QUANTIZED : VERTEX_FORMAT_PACKED;
+}
+
+GLenum ChooseIndexType(const unsigned int* indices, size_t indexCount, size_t vertexCount, vector<IndexRange>& ranges) {
+    ranges.clear();
+    if (vertexCount <= MAX_SHORT_INDEX_SPAN)
+    {
+        ranges.push_back({ 0, indexCount, 0 });
+        return GL_UNSIGNED_SHORT;
+    }
+
+    // grow each range triangle by triangle until the vertices it references span more than 16 bits
+    size_t maxRanges = MAX_INDEX_RANGE_FACTOR * ((vertexCount + MAX_SHORT_INDEX_SPAN - 1) / MAX_SHORT_INDEX_SPAN);
+    size_t first = 0;
+    unsigned int lowest = 0, highest = 0;
+    for (size_t i = 0; i + 3 <= indexCount; i += 3)
+    {
+        unsigned int triangleLowest = std::min(indices[i], std::min(indices[i + 1], indices[i + 2]));
+        unsigned int triangleHighest = std::max(indices[i], std::max(indices[i + 1], indices[i + 2]));
+        if (i > first && (size_t)std::max(highest, triangleHighest) - std::min(lowest, triangleLowest) >= MAX_SHORT_INDEX_SPAN)
+        {
+            ranges.push_back({ first, i - first, (int)lowest });
+            first = i;
+        }
+        lowest = i == first ? triangleLowest : std::min(lowest, triangleLowest);
+        highest = i == first ? triangleHighest : std::max(highest, triangleHighest);
+        // a single triangle spanning more than 16 bits, or a split that fragments too much
+        if ((size_t)highest - lowest >= MAX_SHORT_INDEX_SPAN || ranges.size() >= maxRanges)
+        {
+            ranges.assign(1, { 0, indexCount, 0 });
+            return GL_UNSIGNED_INT;
+        }
+    }
+    if (first < indexCount)
+        ranges.push_back({ first, indexCount - first, (int)lowest });
+    return GL_UNSIGNED_SHORT;
+}
+
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexStreams streams)
+    : vertexStreams(streams)
+{
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
+    lods.assign(1, { 0, this->indices.size(), 0.0f });
+
+    computeBounds();
+    vertexFormat = ChooseVertexFormat(this->vertices.data(), this->vertices.size(), boundsMin, boundsMax);
+    setupMesh(this->vertices.data(), this->indices.data(),
+        HashGeometry(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), vertexFormat, lods));
+}
+
+Mesh::Mesh(const MeshView& view, VertexStreams streams)
+    : boundsMin(view.boundsMin), boundsMax(view.boundsMax), vertexFormat(view.vertexFormat), vertexStreams(streams)
+{
+    this->vertices.assign(view.vertices, view.vertices + view.vertexCount);
+    this->indices.assign(view.indices, view.indices + view.indexCount);
+    this->textures = view.textures;
+    lods = view.lods;
+    meshlets = view.meshlets;
+    if (lods.empty())
+        lods.assign(1, { 0, view.indexCount, 0.0f });
+
+    setupMesh(view.vertices, view.indices, view.geometryHash);
+}
+
+Mesh::Mesh(MeshData&& data, VertexStreams streams)
+    : boundsMin(data.boundsMin), boundsMax(data.boundsMax), vertexFormat(data.vertexFormat), vertexStreams(streams)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    vertices = std::move(data.vertices);
+    indices = std::move(data.indices);
+    textures = std::move(data.textures);
+    lods = std::move(data.lods);
+    meshlets = std::move(data.meshlets);
+    if (lods.empty())
+        lods.assign(1, { 0, indices.size(), 0.0f });
 
-    setupMesh();
+    setupMesh(vertices.data(), indices.data(), data.geometryHash);
 }
 
-void Mesh::Draw(Shader &shader) {
-    // bind appropriate textures
+Mesh::~Mesh() {
+    release();
+}
+
+Mesh::Mesh(Mesh&& other) noexcept : VAO(0), VBO(0), EBO(0), vertexBufferBytes(0), indexBufferBytes(0) {
+    *this = std::move(other);
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept {
+    if (this == &other)
+        return *this;
+
+    release();
+    vertices = std::move(other.vertices);
+    indices = std::move(other.indices);
+    textures = std::move(other.textures);
+    positions = std::move(other.positions);
+    glslIdentifierPrefix = std::move(other.glslIdentifierPrefix);
+    boundsMin = other.boundsMin;
+    boundsMax = other.boundsMax;
+    vertexFormat = other.vertexFormat;
+    vertexStreams = other.vertexStreams;
+    positionOffset = other.positionOffset;
+    positionScale = other.positionScale;
+    lods = std::move(other.lods);
+    materialPrograms.clear();
+    meshlets = std::move(other.meshlets);
+    indexType = other.indexType;
+    indexRanges = std::move(other.indexRanges);
+    drawCounts = std::move(other.drawCounts);
+    drawOffsets = std::move(other.drawOffsets);
+    drawBaseVertices = std::move(other.drawBaseVertices);
+
+    // the moved from mesh keeps no GL objects, releasing name 0 is a no-op
+    VAO = other.VAO;
+    VBO = other.VBO;
+    EBO = other.EBO;
+    vertexBufferBytes = other.vertexBufferBytes;
+    indexBufferBytes = other.indexBufferBytes;
+    other.VAO = other.VBO = other.EBO = 0;
+    other.vertexBufferBytes = other.indexBufferBytes = 0;
+    return *this;
+}
+
+void Mesh::release() {
+    GeometryRegistry::Instance().Release(VAO);
+    VAO = VBO = EBO = 0;
+    vertexBufferBytes = indexBufferBytes = 0;
+}
+
+size_t Mesh::SelectLod(float pixelsPerUnit, float maxPixelError) const {
+    size_t lod = 0;
+    while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= maxPixelError)
+        lod++;
+    return lod;
+}
+
+void Mesh::SetResidency(MeshResidency residency) {
+    if (residency == MESH_RESIDENCY_POSITIONS && positions.empty())
+    {
+        positions.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+    }
+    // swapping with an empty vector gives the memory back, clear() would keep the capacity
+    if (residency != MESH_RESIDENCY_KEEP)
+        vector<Vertex>().swap(vertices);
+    if (residency == MESH_RESIDENCY_DISCARD)
+    {
+        vector<unsigned int>().swap(indices);
+        vector<glm::vec3>().swap(positions);
+    }
+}
+
+size_t Mesh::CpuBytes() const {
+    size_t bytes = vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int)
+        + positions.capacity() * sizeof(glm::vec3) + lods.capacity() * sizeof(MeshLod) + meshlets.capacity() * sizeof(Meshlet);
+    for (const vector<IndexRange>& ranges : indexRanges)
+        bytes += ranges.capacity() * sizeof(IndexRange);
+    return bytes;
+}
+
+size_t Mesh::GpuBytes() const {
+    return vertexBufferBytes + indexBufferBytes;
+}
+
+void Mesh::Draw(Shader &shader, size_t lod) {
+    bindMaterial(shader);
+
+    // draw mesh
+    glBindVertexArray(VAO);
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    for (const IndexRange& range : indexRanges[std::min(lod, indexRanges.size() - 1)])
+        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)range.indexCount, indexType, (void*)(range.firstIndex * indexSize), range.baseVertex);
+    glBindVertexArray(0);
+
+    // always good practice to set everything back to defaults once configured.
+    glActiveTexture(GL_TEXTURE0);
+}
+
+size_t Mesh::DrawVisibleMeshlets(Shader& shader, const glm::vec3& viewer, const glm::vec4 planes[6]) {
+    if (meshlets.empty())
+    {
+        Draw(shader, 0);
+        return lods[0].indexCount / 3;
+    }
+
+    drawCounts.clear();
+    drawOffsets.clear();
+    drawBaseVertices.clear();
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+    const vector<IndexRange>& ranges = indexRanges[0];
+    size_t range = 0;
+    // one draw per run of consecutive visible meshlets, cut where a 16 bit index range ends
+    auto addRun = [&](size_t first, size_t end) {
+        while (first < end)
+        {
+            while (ranges[range].firstIndex + ranges[range].indexCount <= first)
+                range++;
+            size_t pieceEnd = std::min(end, ranges[range].firstIndex + ranges[range].indexCount);
+            drawCounts.push_back((GLsizei)(pieceEnd - first));
+            drawOffsets.push_back((const void*)(first * indexSize));
+            drawBaseVertices.push_back(ranges[range].baseVertex);
+            first = pieceEnd;
+        }
+    };
+
+    size_t runFirst = 0, runEnd = 0, triangles = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        if (!IsMeshletVisible(meshlet, viewer, planes))
+            continue;
+        triangles += meshlet.indexCount / 3;
+        if (meshlet.firstIndex != runEnd)
+        {
+            addRun(runFirst, runEnd);
+            runFirst = meshlet.firstIndex;
+        }
+        runEnd = meshlet.firstIndex + meshlet.indexCount;
+    }
+    addRun(runFirst, runEnd);
+    if (drawCounts.empty())
+        return 0;
+
+    bindMaterial(shader);
+    glBindVertexArray(VAO);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), indexType, drawOffsets.data(), (GLsizei)drawCounts.size(), drawBaseVertices.data());
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+    return triangles;
+}
+
+void Mesh::bindMaterial(Shader& shader) {
+    MaterialProgram& program = materialProgram(shader);
+
+    // meshes of a model mostly share their texture arrays, so most binds are skipped and only the layers change
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        if (program.units[i] < 0 || textures[i].isVirtual)
+            continue;
+        bool loaded = textures[i].id != 0;
+        bindMaterialTexture(program.units[i], GL_TEXTURE_2D_ARRAY, loaded ? textures[i].id : placeholder());
+        glUniform1f(program.layerLocations[i], loaded ? (float)textures[i].layer : 0.0f);
+    }
+
+    // a virtual diffuse map samples through its page table instead
+    VirtualTextureCache::Parameters parameters;
+    bool isVirtual = program.diffuse >= 0 && textures[program.diffuse].isVirtual
+        && VirtualTextureCache::Instance().GetParameters(textures[program.diffuse].id, parameters);
+    glUniform1i(program.virtualLocation, isVirtual);
+    if (isVirtual)
+    {
+        bindMaterialTexture(VIRTUAL_PAGE_TABLE_UNIT, GL_TEXTURE_2D, textures[program.diffuse].id);
+        bindMaterialTexture(VIRTUAL_ATLAS_UNIT, GL_TEXTURE_2D, VirtualTextureCache::Instance().AtlasTexture());
+        glUniform4fv(program.virtualSizeLocation, 1, &parameters.size[0]);
+        glUniform1f(program.virtualIndexLocation, parameters.index);
+    }
+
+    // packed layouts are decoded by the vertex shader
+    shader.setVec3("positionOffset", positionOffset);
+    shader.setVec3("positionScale", positionScale);
+    shader.setBool("octahedralNormals", vertexFormat != VERTEX_FORMAT_FLOAT);
+}
+
+Mesh::MaterialProgram& Mesh::materialProgram(Shader& shader) {
+    for (MaterialProgram& program : materialPrograms)
+        if (program.program == shader.GetID() && program.prefix == glslIdentifierPrefix && program.units.size() == textures.size())
+            return program;
+
+    // the samplers only change with the program, every mesh drawn with it puts the same type on the same unit
+    MaterialProgram program;
+    program.program = shader.GetID();
+    program.prefix = glslIdentifierPrefix;
+    program.diffuse = -1;
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
     for (unsigned int i = 0; i < textures.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
         // retrieve texture number (the N in diffuse_textureN)
-        string number;
+        unsigned int number = 0;
+        GLint firstUnit = -1;
         string name = textures[i].type;
         if (name == "texture_diffuse")
-            number = std::to_string(diffuseNr++);
+        {
+            if (diffuseNr == 1)
+                program.diffuse = (int)i;
+            number = diffuseNr++;
+            firstUnit = 0;
+        }
         else if (name == "texture_specular")
-            number = std::to_string(specularNr++); // transfer unsigned int to stream
+        {
+            number = specularNr++;
+            firstUnit = MATERIAL_UNITS_PER_TYPE;
+        }
         else if (name == "texture_normal")
-            number = std::to_string(normalNr++); // transfer unsigned int to stream
+        {
+            number = normalNr++;
+            firstUnit = 2 * MATERIAL_UNITS_PER_TYPE;
+        }
         else if (name == "texture_height")
-            number = std::to_string(heightNr++); // transfer unsigned int to stream
+        {
+            number = heightNr++;
+            firstUnit = 3 * MATERIAL_UNITS_PER_TYPE;
+        }
+        GLint unit = firstUnit >= 0 && (GLint)number <= MATERIAL_UNITS_PER_TYPE ? firstUnit + (GLint)number - 1 : -1;
 
         // now set the sampler to the correct texture unit
-        glUniform1i(glGetUniformLocation(shader.GetID(), (glslIdentifierPrefix + name + number).c_str()), i);
-        // and finally bind the texture
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        string uniform = glslIdentifierPrefix + name + std::to_string(number);
+        if (unit >= 0)
+            glUniform1i(glGetUniformLocation(program.program, uniform.c_str()), unit);
+        program.units.push_back(unit);
+        program.layerLocations.push_back(glGetUniformLocation(program.program, (uniform + "Layer").c_str()));
     }
 
+    // set even if the mesh has no virtual texture: samplers of different types must not share a unit
+    string diffuse = glslIdentifierPrefix + "texture_diffuse1";
+    glUniform1i(glGetUniformLocation(program.program, (diffuse + "PageTable").c_str()), VIRTUAL_PAGE_TABLE_UNIT);
+    glUniform1i(glGetUniformLocation(program.program, "virtualAtlas"), VIRTUAL_ATLAS_UNIT);
+    glUniform1f(glGetUniformLocation(program.program, "virtualAtlasTiles"), (float)VirtualTextureCache::Instance().AtlasTiles());
+    program.virtualLocation = glGetUniformLocation(program.program, (diffuse + "Virtual").c_str());
+    program.virtualSizeLocation = glGetUniformLocation(program.program, (diffuse + "VirtualSize").c_str());
+    program.virtualIndexLocation = glGetUniformLocation(program.program, (diffuse + "VirtualIndex").c_str());
+    materialPrograms.push_back(program);
+    return materialPrograms.back();
+}
 
+void Mesh::ResetBoundTextures() {
+    for (unsigned int& texture : boundMaterialTextures)
+        texture = 0;
+}
 
-    // draw mesh
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+string Mesh::SamplerName(const vector<Texture>& textures, size_t i, const string& prefix) {
+    unsigned int number = 1;
+    for (size_t other = 0; other < i; other++)
+        if (textures[other].type == textures[i].type)
+            number++;
+    return prefix + textures[i].type + std::to_string(number);
+}
 
-    // always good practice to set everything back to defaults once configured.
-    glActiveTexture(GL_TEXTURE0);
+void Mesh::computeBounds() {
+    boundsMin = glm::vec3(0.0f);
+    boundsMax = glm::vec3(0.0f);
+    if (vertices.empty())
+        return;
+
+    boundsMin = boundsMax = vertices[0].Position;
+    for (const Vertex& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+    }
 }
 
-void Mesh::setupMesh() {
+ContentHash HashGeometry(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+    VertexFormat vertexFormat, const vector<MeshLod>& lods) {
+    ContentHash hash = HashBytes(vertices, vertexCount * sizeof(Vertex));
+    hash = HashBytes(indices, indexCount * sizeof(unsigned int), hash);
+    uint32_t format = (uint32_t)vertexFormat;
+    hash = HashBytes(&format, sizeof(format), hash);
+    for (const MeshLod& lod : lods)
+    {
+        uint64_t range[2] = { lod.firstIndex, lod.indexCount };
+        hash = HashBytes(range, sizeof(range), hash);
+    }
+    return hash;
+}
+
+void Mesh::setupMesh(const Vertex* vertexData, const unsigned int* indexData, const ContentHash& geometryHash) {
+    // another copy of this geometry is on the GPU already, with the same streams
+    uint32_t streams = (uint32_t)vertexStreams;
+    ContentHash buffersHash = HashBytes(&streams, sizeof(streams), geometryHash);
+    if (const GeometryRegistry::Buffers* shared = GeometryRegistry::Instance().Acquire(buffersHash))
+    {
+        VAO = shared->VAO;
+        VBO = shared->VBO;
+        EBO = shared->EBO;
+        vertexBufferBytes = shared->vertexBufferBytes;
+        indexBufferBytes = shared->indexBufferBytes;
+        indexType = shared->indexType;
+        indexRanges = shared->indexRanges;
+        positionOffset = shared->positionOffset;
+        positionScale = shared->positionScale;
+        return;
+    }
+
+    uploadBuffers(vertexData, indexData);
+    GeometryRegistry::Buffers buffers = { VAO, VBO, EBO, vertexBufferBytes, indexBufferBytes, indexType, indexRanges, positionOffset, positionScale };
+    GeometryRegistry::Instance().Add(buffersHash, buffers);
+}
+
+void Mesh::uploadBuffers(const Vertex* vertexData, const unsigned int* indexData) {
     // create buffers/arrays
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
     glBindVertexArray(VAO);
-    // load data into vertex buffers
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    // 16 bit indices only if every level can use them
+    indexRanges.assign(lods.size(), vector<IndexRange>());
+    indexType = GL_UNSIGNED_SHORT;
+    for (size_t lod = 0; lod < lods.size() && indexType == GL_UNSIGNED_SHORT; lod++)
+    {
+        indexType = ChooseIndexType(indexData + lods[lod].firstIndex, lods[lod].indexCount, vertices.size(), indexRanges[lod]);
+        for (IndexRange& range : indexRanges[lod])
+            range.firstIndex += lods[lod].firstIndex;
+    }
+    if (indexType == GL_UNSIGNED_INT)
+    {
+        for (size_t lod = 0; lod < lods.size(); lod++)
+            indexRanges[lod].assign(1, { lods[lod].firstIndex, lods[lod].indexCount, 0 });
+    }
+
+    if (indexType == GL_UNSIGNED_SHORT)
+    {
+        // indices are stored relative to the base vertex of their range
+        indexBufferBytes = indices.size() * sizeof(uint16_t);
+        uploadConverted<uint16_t>(GL_ELEMENT_ARRAY_BUFFER, indices.size(), [&](uint16_t* shortIndices) {
+            for (const vector<IndexRange>& ranges : indexRanges)
+                for (const IndexRange& range : ranges)
+                    for (size_t i = range.firstIndex; i < range.firstIndex + range.indexCount; i++)
+                        shortIndices[i] = (uint16_t)(indexData[i] - range.baseVertex);
+        });
+    }
+    else
+    {
+        indexBufferBytes = indices.size() * sizeof(unsigned int);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes, indexData, GL_STATIC_DRAW);
+    }
+
+    // load data into vertex buffers, only the streams the mesh's shaders read
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for all its items.
-    // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-    // again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    positionOffset = glm::vec3(0.0f);
+    positionScale = glm::vec3(1.0f);
+    StreamLayout layout = streamLayout(vertexFormat, vertexStreams);
+    vertexBufferBytes = vertices.size() * layout.stride;
+    if (vertexFormat == VERTEX_FORMAT_QUANTIZED)
+    {
+        // snorm positions span the bounds, flat axes keep a scale of 1 so nothing divides by zero
+        positionOffset = (boundsMin + boundsMax) * 0.5f;
+        positionScale = (boundsMax - boundsMin) * 0.5f;
+        for (int axis = 0; axis < 3; axis++)
+            if (positionScale[axis] <= 0.0f)
+                positionScale[axis] = 1.0f;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        uploadStreams<QuantizedVertex>(vertexFormat, layout, vertices.size(), [&](size_t i, QuantizedVertex& packed) {
+            glm::vec3 position = (vertexData[i].Position - positionOffset) / positionScale;
+            for (int axis = 0; axis < 3; axis++)
+                packed.Position[axis] = toSnorm16(position[axis]);
+            packed.Position[3] = 0;
+            packAttributes(vertexData[i], packed);
+        });
+    }
+    else if (vertexFormat == VERTEX_FORMAT_PACKED)
+    {
+        uploadStreams<PackedVertex>(vertexFormat, layout, vertices.size(), [&](size_t i, PackedVertex& packed) {
+            for (int axis = 0; axis < 3; axis++)
+                packed.Position[axis] = vertexData[i].Position[axis];
+            packAttributes(vertexData[i], packed);
+        });
+    }
+    else if (layout.stride == (GLsizei)sizeof(Vertex))
+    {
+        // A great thing about structs is that their memory layout is sequential for all its items.
+        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+        // again translates to 3/2 floats which translates to a byte array.
+        glBufferData(GL_ARRAY_BUFFER, vertexBufferBytes, vertexData, GL_STATIC_DRAW);
+    }
+    else
+    {
+        uploadStreams<Vertex>(vertexFormat, layout, vertices.size(), [&](size_t i, Vertex& vertex) {
+            vertex = vertexData[i];
+        });
+    }
 
     // set the vertex attribute pointers
-    // vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-    // vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-    // vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
+    setAttributePointers(vertexFormat, layout);
     glBindVertexArray(0);
 }
\ No newline at end of file
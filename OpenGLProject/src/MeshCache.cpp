@@ -0,0 +1,414 @@
+#include <lib/MeshCache.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+    const char CacheMagic[4] = { 'M', 'S', 'H', 'C' };
+
+    struct CacheHeader {
+        char     magic[4];
+        uint32_t version;
+        uint32_t importFlags;
+        uint32_t vertexStride;
+        int64_t  sourceModifiedTime;
+        uint64_t sourceSize;
+        uint64_t sourceHash[2];
+        uint32_t meshCount;
+        uint32_t dependencyCount;
+        uint32_t sourcePathLength;
+    };
+
+    // another file the import read, a material library most of all
+    struct CacheDependencyRecord {
+        int64_t  modifiedTime;
+        uint64_t size;
+        uint64_t hash[2];
+        uint32_t pathLength;
+    };
+
+    struct CacheMeshRecord {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t vertexFormat;
+        uint32_t lodCount;
+        uint32_t meshletCount;
+        float    boundsMin[3];
+        float    boundsMax[3];
+    };
+
+    struct CacheLodRecord {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float    error;
+    };
+
+    struct CacheMeshletRecord {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float    center[3];
+        float    radius;
+        float    coneAxis[3];
+        float    coneCutoff;
+    };
+
+    struct CacheTextureRecord {
+        uint32_t typeLength;
+        uint32_t pathLength;
+    };
+
+    size_t alignUp(size_t offset) {
+        return (offset + 3) & ~(size_t)3;
+    }
+
+    void append(vector<char>& buffer, const void* data, size_t size) {
+        const char* bytes = (const char*)data;
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    void pad(vector<char>& buffer) {
+        buffer.resize(alignUp(buffer.size()), 0);
+    }
+
+    // bounds checked cursor over the mapped file, every read fails once the data runs out
+    struct Reader {
+        const unsigned char* data;
+        size_t size;
+        size_t offset;
+
+        const void* take(size_t count) {
+            if (count > size - offset)
+                return nullptr;
+            const void* result = data + offset;
+            offset += count;
+            return result;
+        }
+
+        bool align() {
+            size_t aligned = alignUp(offset);
+            if (aligned > size)
+                return false;
+            offset = aligned;
+            return true;
+        }
+
+        // whether count more records of recordSize bytes can still follow, checked before reserving for them
+        bool fits(size_t count, size_t recordSize) const {
+            return count <= (size - offset) / recordSize;
+        }
+
+        // count records of recordSize bytes; the size is checked before it's multiplied, size_t is 32 bit on Win32
+        const void* takeArray(size_t count, size_t recordSize) {
+            return fits(count, recordSize) ? take(count * recordSize) : nullptr;
+        }
+    };
+
+    // same check as for the source: equal stamp, or equal contents after a copy
+    bool isCurrent(const string& path, int64_t modifiedTime, uint64_t size, const uint64_t hash[2]) {
+        FileStamp stamp;
+        if (!GetFileStamp(path, stamp) || stamp.size != size)
+            return false;
+        if (stamp.modifiedTime == modifiedTime)
+            return true;
+        ContentHash contents;
+        return HashFile(path, contents) && contents.low == hash[0] && contents.high == hash[1];
+    }
+
+}
+
+string MeshCache::CachePathFor(const string& sourcePath) {
+    return sourcePath + ".meshcache";
+}
+
+bool MeshCache::Open(const string& sourcePath, unsigned int importFlags) {
+    Close();
+
+    FileStamp stamp;
+    if (!GetFileStamp(sourcePath, stamp) || !m_file.Open(CachePathFor(sourcePath)))
+        return false;
+
+    Reader reader = { m_file.Data(), m_file.Size(), 0 };
+    const CacheHeader* header = (const CacheHeader*)reader.take(sizeof(CacheHeader));
+    if (!header
+        || std::memcmp(header->magic, CacheMagic, sizeof(CacheMagic)) != 0
+        || header->version != Version
+        || header->importFlags != importFlags
+        || header->vertexStride != sizeof(Vertex)
+        || header->sourceSize != stamp.size)
+    {
+        Close();
+        return false;
+    }
+
+    // a copied or deployed source has a new modification time, its contents tell whether it is still the same file
+    if (!isCurrent(sourcePath, header->sourceModifiedTime, header->sourceSize, header->sourceHash))
+    {
+        Close();
+        return false;
+    }
+
+    const char* storedPath = (const char*)reader.take(header->sourcePathLength);
+    if (!storedPath || sourcePath.compare(0, string::npos, storedPath, header->sourcePathLength) != 0 || !reader.align())
+    {
+        Close();
+        return false;
+    }
+
+    // an edited material library changes the textures the meshes reference
+    for (uint32_t d = 0; d < header->dependencyCount; d++)
+    {
+        const CacheDependencyRecord* dependency = (const CacheDependencyRecord*)reader.take(sizeof(CacheDependencyRecord));
+        const char* path = dependency ? (const char*)reader.take(dependency->pathLength) : nullptr;
+        if (!path || !reader.align())
+        {
+            Close();
+            return false;
+        }
+        m_dependencies.emplace_back(path, dependency->pathLength);
+        if (!isCurrent(m_dependencies.back(), dependency->modifiedTime, dependency->size, dependency->hash))
+        {
+            Close();
+            return false;
+        }
+    }
+
+    // a damaged count mustn't make the reserve below allocate more than the file could ever describe
+    if (!reader.fits(header->meshCount, sizeof(CacheMeshRecord)))
+    {
+        Close();
+        return false;
+    }
+    m_entries.reserve(header->meshCount);
+    for (uint32_t i = 0; i < header->meshCount; i++)
+    {
+        const CacheMeshRecord* record = (const CacheMeshRecord*)reader.take(sizeof(CacheMeshRecord));
+        // the format indexes the stream layouts, a damaged one mustn't read past them
+        if (!record || record->vertexFormat > VERTEX_FORMAT_QUANTIZED)
+        {
+            Close();
+            return false;
+        }
+
+        MeshView entry;
+        entry.vertexCount = record->vertexCount;
+        entry.indexCount = record->indexCount;
+        entry.boundsMin = glm::vec3(record->boundsMin[0], record->boundsMin[1], record->boundsMin[2]);
+        entry.boundsMax = glm::vec3(record->boundsMax[0], record->boundsMax[1], record->boundsMax[2]);
+        entry.vertexFormat = (VertexFormat)record->vertexFormat;
+
+        for (uint32_t l = 0; l < record->lodCount; l++)
+        {
+            const CacheLodRecord* lodRecord = (const CacheLodRecord*)reader.take(sizeof(CacheLodRecord));
+            if (!lodRecord || (uint64_t)lodRecord->firstIndex + lodRecord->indexCount > entry.indexCount)
+            {
+                Close();
+                return false;
+            }
+            entry.lods.push_back({ lodRecord->firstIndex, lodRecord->indexCount, lodRecord->error });
+        }
+
+        for (uint32_t m = 0; m < record->meshletCount; m++)
+        {
+            const CacheMeshletRecord* meshletRecord = (const CacheMeshletRecord*)reader.take(sizeof(CacheMeshletRecord));
+            if (!meshletRecord || (uint64_t)meshletRecord->firstIndex + meshletRecord->indexCount > entry.indexCount)
+            {
+                Close();
+                return false;
+            }
+            Meshlet meshlet;
+            meshlet.firstIndex = meshletRecord->firstIndex;
+            meshlet.indexCount = meshletRecord->indexCount;
+            meshlet.center = glm::vec3(meshletRecord->center[0], meshletRecord->center[1], meshletRecord->center[2]);
+            meshlet.radius = meshletRecord->radius;
+            meshlet.coneAxis = glm::vec3(meshletRecord->coneAxis[0], meshletRecord->coneAxis[1], meshletRecord->coneAxis[2]);
+            meshlet.coneCutoff = meshletRecord->coneCutoff;
+            entry.meshlets.push_back(meshlet);
+        }
+
+        for (uint32_t t = 0; t < record->textureCount; t++)
+        {
+            const CacheTextureRecord* textureRecord = (const CacheTextureRecord*)reader.take(sizeof(CacheTextureRecord));
+            const char* type = textureRecord ? (const char*)reader.take(textureRecord->typeLength) : nullptr;
+            const char* path = type ? (const char*)reader.take(textureRecord->pathLength) : nullptr;
+            if (!path || !reader.align())
+            {
+                Close();
+                return false;
+            }
+
+            Texture texture;
+            texture.id = 0;
+            texture.type.assign(type, textureRecord->typeLength);
+            texture.path.assign(path, textureRecord->pathLength);
+            entry.textures.push_back(texture);
+        }
+
+        entry.vertices = (const Vertex*)reader.takeArray(entry.vertexCount, sizeof(Vertex));
+        entry.indices = entry.vertices ? (const unsigned int*)reader.takeArray(entry.indexCount, sizeof(unsigned int)) : nullptr;
+        if (!entry.indices)
+        {
+            Close();
+            return false;
+        }
+        entry.geometryHash = HashGeometry(entry.vertices, entry.vertexCount, entry.indices, entry.indexCount, entry.vertexFormat, entry.lods);
+
+        m_entries.push_back(entry);
+    }
+
+    return true;
+}
+
+void MeshCache::Close() {
+    m_entries.clear();
+    m_dependencies.clear();
+    m_file.Close();
+}
+
+const vector<MeshView>& MeshCache::Entries() const {
+    return m_entries;
+}
+
+const vector<string>& MeshCache::Dependencies() const {
+    return m_dependencies;
+}
+
+bool MeshCache::Store(const string& sourcePath, unsigned int importFlags, const vector<MeshData>& meshes, const vector<string>& dependencies) {
+    FileStamp stamp;
+    ContentHash hash;
+    if (!GetFileStamp(sourcePath, stamp) || !HashFile(sourcePath, hash))
+        return false;
+
+    vector<CacheDependencyRecord> dependencyRecords(dependencies.size());
+    for (size_t d = 0; d < dependencies.size(); d++)
+    {
+        FileStamp dependencyStamp;
+        ContentHash dependencyHash;
+        if (!GetFileStamp(dependencies[d], dependencyStamp) || !HashFile(dependencies[d], dependencyHash))
+            return false;
+        dependencyRecords[d].modifiedTime = dependencyStamp.modifiedTime;
+        dependencyRecords[d].size = dependencyStamp.size;
+        dependencyRecords[d].hash[0] = dependencyHash.low;
+        dependencyRecords[d].hash[1] = dependencyHash.high;
+        dependencyRecords[d].pathLength = (uint32_t)dependencies[d].size();
+    }
+
+    size_t totalSize = sizeof(CacheHeader) + sourcePath.size() + 4;
+    for (const string& dependency : dependencies)
+        totalSize += sizeof(CacheDependencyRecord) + dependency.size() + 4;
+    for (const MeshData& mesh : meshes)
+    {
+        totalSize += sizeof(CacheMeshRecord) + mesh.lods.size() * sizeof(CacheLodRecord) + mesh.meshlets.size() * sizeof(CacheMeshletRecord)
+            + mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+        for (const Texture& texture : mesh.textures)
+            totalSize += sizeof(CacheTextureRecord) + texture.type.size() + texture.path.size() + 4;
+    }
+
+    vector<char> buffer;
+    buffer.reserve(totalSize);
+
+    CacheHeader header;
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = Version;
+    header.importFlags = importFlags;
+    header.vertexStride = sizeof(Vertex);
+    header.sourceModifiedTime = stamp.modifiedTime;
+    header.sourceSize = stamp.size;
+    header.sourceHash[0] = hash.low;
+    header.sourceHash[1] = hash.high;
+    header.meshCount = (uint32_t)meshes.size();
+    header.dependencyCount = (uint32_t)dependencies.size();
+    header.sourcePathLength = (uint32_t)sourcePath.size();
+    append(buffer, &header, sizeof(header));
+    append(buffer, sourcePath.data(), sourcePath.size());
+    pad(buffer);
+
+    for (size_t d = 0; d < dependencies.size(); d++)
+    {
+        append(buffer, &dependencyRecords[d], sizeof(CacheDependencyRecord));
+        append(buffer, dependencies[d].data(), dependencies[d].size());
+        pad(buffer);
+    }
+
+    for (const MeshData& mesh : meshes)
+    {
+        CacheMeshRecord record;
+        record.vertexCount = (uint32_t)mesh.vertices.size();
+        record.indexCount = (uint32_t)mesh.indices.size();
+        record.textureCount = (uint32_t)mesh.textures.size();
+        record.vertexFormat = (uint32_t)mesh.vertexFormat;
+        record.lodCount = (uint32_t)mesh.lods.size();
+        record.meshletCount = (uint32_t)mesh.meshlets.size();
+        for (int axis = 0; axis < 3; axis++)
+        {
+            record.boundsMin[axis] = mesh.boundsMin[axis];
+            record.boundsMax[axis] = mesh.boundsMax[axis];
+        }
+        append(buffer, &record, sizeof(record));
+
+        for (const MeshLod& lod : mesh.lods)
+        {
+            CacheLodRecord lodRecord;
+            lodRecord.firstIndex = (uint32_t)lod.firstIndex;
+            lodRecord.indexCount = (uint32_t)lod.indexCount;
+            lodRecord.error = lod.error;
+            append(buffer, &lodRecord, sizeof(lodRecord));
+        }
+
+        for (const Meshlet& meshlet : mesh.meshlets)
+        {
+            CacheMeshletRecord meshletRecord;
+            meshletRecord.firstIndex = (uint32_t)meshlet.firstIndex;
+            meshletRecord.indexCount = (uint32_t)meshlet.indexCount;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                meshletRecord.center[axis] = meshlet.center[axis];
+                meshletRecord.coneAxis[axis] = meshlet.coneAxis[axis];
+            }
+            meshletRecord.radius = meshlet.radius;
+            meshletRecord.coneCutoff = meshlet.coneCutoff;
+            append(buffer, &meshletRecord, sizeof(meshletRecord));
+        }
+
+        for (const Texture& texture : mesh.textures)
+        {
+            CacheTextureRecord textureRecord;
+            textureRecord.typeLength = (uint32_t)texture.type.size();
+            textureRecord.pathLength = (uint32_t)texture.path.size();
+            append(buffer, &textureRecord, sizeof(textureRecord));
+            append(buffer, texture.type.data(), texture.type.size());
+            append(buffer, texture.path.data(), texture.path.size());
+            pad(buffer);
+        }
+
+        append(buffer, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+        append(buffer, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    }
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind
+    string cachePath = CachePathFor(sourcePath);
+    string tempPath = TempPathFor(cachePath);
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write(buffer.data(), buffer.size());
+        if (!out)
+        {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    // another writer may have put the same cache in place meanwhile, this one's copy is dropped then
+    std::remove(cachePath.c_str());
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,454 @@
+#include <lib/MeshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+
+    const unsigned int UNUSED_VERTEX = ~0u;
+
+    // FIFO cache simulated with timestamps: a vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since its own
+    struct CacheSimulator {
+        vector<unsigned int> loadedAt;
+        unsigned int time;
+
+        explicit CacheSimulator(size_t vertexCount) : loadedAt(vertexCount, 0), time(VERTEX_CACHE_SIZE + 1) {
+        }
+
+        // returns true on a miss
+        bool access(unsigned int vertex) {
+            if (time - loadedAt[vertex] <= VERTEX_CACHE_SIZE)
+                return false;
+            loadedAt[vertex] = time++;
+            return true;
+        }
+
+        void flush() {
+            time += VERTEX_CACHE_SIZE + 1;
+        }
+    };
+
+    // floats per Vertex, all of them take part in welding
+    const size_t VERTEX_COMPONENTS = sizeof(Vertex) / sizeof(float);
+
+    // a triangle whose height is below this fraction of its longest edge has no area worth drawing
+    const float DEGENERATE_HEIGHT_RATIO = 1e-6f;
+
+    // triangle with its indices rotated so the smallest comes first, which keeps the winding
+    struct TriangleKey {
+        unsigned int a, b, c;
+
+        bool operator==(const TriangleKey& other) const {
+            return a == other.a && b == other.b && c == other.c;
+        }
+    };
+
+    struct TriangleKeyHash {
+        size_t operator()(const TriangleKey& key) const {
+            return (size_t)(((uint64_t)key.a * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)key.b * 0xC2B2AE3D27D4EB4Full) ^ ((uint64_t)key.c * 0x165667B19E3779F9ull));
+        }
+    };
+
+    TriangleKey makeTriangleKey(unsigned int a, unsigned int b, unsigned int c) {
+        if (b < a && b < c)
+            return { b, c, a };
+        if (c < a && c < b)
+            return { c, a, b };
+        return { a, b, c };
+    }
+
+    uint64_t hashComponents(const int64_t* components) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < VERTEX_COMPONENTS; i++)
+        {
+            hash ^= (uint64_t)components[i];
+            hash *= 1099511628211ull;
+            hash ^= hash >> 29;
+        }
+        return hash;
+    }
+
+    struct Cluster {
+        size_t firstTriangle;
+        size_t triangleCount;
+        float sortKey;
+    };
+
+}
+
+float VertexCacheStats::ACMR() const {
+    return triangles > 0 ? (float)transformedVertices / triangles : 0.0f;
+}
+
+float VertexCacheStats::ATVR() const {
+    return vertices > 0 ? (float)transformedVertices / vertices : 0.0f;
+}
+
+VertexCacheStats& VertexCacheStats::operator+=(const VertexCacheStats& other) {
+    transformedVertices += other.transformedVertices;
+    triangles += other.triangles;
+    vertices += other.vertices;
+    return *this;
+}
+
+float WeldStats::VertexReduction() const {
+    return verticesBefore > 0 ? 1.0f - (float)verticesAfter / verticesBefore : 0.0f;
+}
+
+float WeldStats::TriangleReduction() const {
+    return trianglesBefore > 0 ? 1.0f - (float)trianglesAfter / trianglesBefore : 0.0f;
+}
+
+void WeldVertices(vector<Vertex>& vertices, vector<unsigned int>& indices, float epsilon) {
+    size_t vertexCount = vertices.size();
+    if (vertexCount == 0)
+        return;
+
+    // every vertex as integers: its components snapped to the epsilon grid, or their bits when welding exactly
+    vector<int64_t> keys(vertexCount * VERTEX_COMPONENTS);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        const float* components = (const float*)&vertices[v];
+        for (size_t i = 0; i < VERTEX_COMPONENTS; i++)
+        {
+            float component = components[i] == 0.0f ? 0.0f : components[i];
+            if (epsilon > 0.0f)
+            {
+                keys[v * VERTEX_COMPONENTS + i] = (int64_t)std::floor((double)component / epsilon + 0.5);
+            }
+            else
+            {
+                int32_t bits;
+                std::memcpy(&bits, &component, sizeof(bits));
+                keys[v * VERTEX_COMPONENTS + i] = bits;
+            }
+        }
+    }
+
+    // open addressing table of the first vertex of each group, at most half full
+    size_t tableSize = 1;
+    while (tableSize < vertexCount * 2)
+        tableSize *= 2;
+    vector<unsigned int> table(tableSize, UNUSED_VERTEX);
+    vector<unsigned int> remap(vertexCount);
+    vector<Vertex> welded;
+    welded.reserve(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        const int64_t* key = &keys[v * VERTEX_COMPONENTS];
+        size_t slot = (size_t)hashComponents(key) & (tableSize - 1);
+        while (table[slot] != UNUSED_VERTEX && std::memcmp(&keys[table[slot] * VERTEX_COMPONENTS], key, VERTEX_COMPONENTS * sizeof(int64_t)) != 0)
+            slot = (slot + 1) & (tableSize - 1);
+
+        if (table[slot] == UNUSED_VERTEX)
+        {
+            table[slot] = (unsigned int)v;
+            remap[v] = (unsigned int)welded.size();
+            welded.push_back(vertices[v]);
+        }
+        else
+        {
+            remap[v] = remap[table[slot]];
+        }
+    }
+
+    for (unsigned int& index : indices)
+        index = remap[index];
+    vertices.swap(welded);
+}
+
+void RemoveDegenerateTriangles(vector<Vertex>& vertices, vector<unsigned int>& indices) {
+    size_t triangleCount = indices.size() / 3;
+    unordered_set<TriangleKey, TriangleKeyHash> seen;
+    seen.reserve(triangleCount);
+
+    size_t kept = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        unsigned int a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+        if (a == b || b == c || a == c)
+            continue;
+
+        const glm::vec3& p0 = vertices[a].Position;
+        const glm::vec3& p1 = vertices[b].Position;
+        const glm::vec3& p2 = vertices[c].Position;
+        float longestEdge = std::max(glm::length(p1 - p0), std::max(glm::length(p2 - p1), glm::length(p0 - p2)));
+        // twice the area over the longest edge is the smallest height
+        if (!(glm::length(glm::cross(p1 - p0, p2 - p0)) > DEGENERATE_HEIGHT_RATIO * longestEdge * longestEdge))
+            continue;
+
+        if (!seen.insert(makeTriangleKey(a, b, c)).second)
+            continue;
+
+        indices[kept * 3] = a;
+        indices[kept * 3 + 1] = b;
+        indices[kept * 3 + 2] = c;
+        kept++;
+    }
+    indices.resize(kept * 3);
+
+    // compact the vertices the dropped triangles left unused, keeping their order
+    vector<unsigned int> remap(vertices.size(), UNUSED_VERTEX);
+    for (unsigned int index : indices)
+        remap[index] = 0;
+    size_t used = 0;
+    for (size_t v = 0; v < vertices.size(); v++)
+    {
+        if (remap[v] == UNUSED_VERTEX)
+            continue;
+        remap[v] = (unsigned int)used;
+        vertices[used++] = vertices[v];
+    }
+    vertices.resize(used);
+    for (unsigned int& index : indices)
+        index = remap[index];
+}
+
+WeldStats WeldMesh(MeshData& mesh, float epsilon) {
+    WeldStats stats;
+    stats.verticesBefore = mesh.vertices.size();
+    stats.trianglesBefore = mesh.indices.size() / 3;
+
+    WeldVertices(mesh.vertices, mesh.indices, epsilon);
+    RemoveDegenerateTriangles(mesh.vertices, mesh.indices);
+
+    stats.verticesAfter = mesh.vertices.size();
+    stats.trianglesAfter = mesh.indices.size() / 3;
+    return stats;
+}
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount) {
+    VertexCacheStats stats;
+    stats.triangles = indexCount / 3;
+    stats.vertices = vertexCount;
+
+    CacheSimulator cache(vertexCount);
+    for (size_t i = 0; i < stats.triangles * 3; i++)
+        if (cache.access(indices[i]))
+            stats.transformedVertices++;
+    return stats;
+}
+
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount, vector<size_t>* clusterStarts) {
+    size_t triangleCount = indexCount / 3;
+    if (clusterStarts)
+        clusterStarts->clear();
+    if (triangleCount == 0)
+        return;
+
+    // triangles using each vertex, vertex v owns adjacency[offsets[v] .. offsets[v + 1])
+    vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        liveTriangles[indices[i]]++;
+    vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + liveTriangles[v];
+    vector<unsigned int> adjacency(triangleCount * 3);
+    vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    vector<unsigned int> cacheTime(vertexCount, 0);
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> deadEnds;
+    vector<unsigned int> candidates;
+    vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+
+    unsigned int time = VERTEX_CACHE_SIZE + 1;
+    size_t cursor = 0;
+    unsigned int fanning = 0;
+    bool coldStart = true;
+    while (true)
+    {
+        if (coldStart && clusterStarts)
+            clusterStarts->push_back(result.size());
+
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (size_t a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+        {
+            unsigned int triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int vertex = indices[triangle * 3 + corner];
+                result.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+                if (time - cacheTime[vertex] > VERTEX_CACHE_SIZE)
+                    cacheTime[vertex] = time++;
+            }
+        }
+
+        // next fan: the candidate that is still in the cache after its remaining triangles are emitted and
+        // entered it earliest, so its reuse is least likely to be lost
+        unsigned int next = UNUSED_VERTEX;
+        int best = -1;
+        for (unsigned int vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= VERTEX_CACHE_SIZE)
+                priority = (int)(time - cacheTime[vertex]);
+            if (priority > best)
+            {
+                best = priority;
+                next = vertex;
+            }
+        }
+
+        // dead end: back up to a recently used vertex, or scan for any vertex with triangles left
+        coldStart = false;
+        while (next == UNUSED_VERTEX && !deadEnds.empty())
+        {
+            unsigned int vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[vertex] > 0)
+                next = vertex;
+        }
+        while (next == UNUSED_VERTEX && cursor < vertexCount)
+        {
+            if (liveTriangles[cursor] > 0)
+            {
+                next = (unsigned int)cursor;
+                coldStart = true;
+            }
+            cursor++;
+        }
+        if (next == UNUSED_VERTEX)
+            break;
+        fanning = next;
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void OptimizeOverdraw(unsigned int* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount,
+    const vector<size_t>& clusterStarts, float threshold) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || clusterStarts.empty())
+        return;
+
+    // split each cold start run into smaller clusters wherever the part so far reuses the cache about as well as the
+    // whole run does. Every cluster is measured from a flushed cache, so the reordered list stays within the threshold.
+    vector<Cluster> clusters;
+    CacheSimulator cache(vertexCount);
+    for (size_t c = 0; c < clusterStarts.size(); c++)
+    {
+        size_t first = clusterStarts[c] / 3;
+        size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] / 3 : triangleCount;
+        size_t misses = 0;
+        cache.flush();
+        for (size_t i = first * 3; i < end * 3; i++)
+            if (cache.access(indices[i]))
+                misses++;
+        float targetACMR = (float)misses / (end - first) * threshold;
+
+        size_t runClusters = clusters.size();
+        misses = 0;
+        cache.flush();
+        for (size_t t = first; t < end; t++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+                if (cache.access(indices[t * 3 + corner]))
+                    misses++;
+            if (misses <= targetACMR * (t + 1 - first))
+            {
+                clusters.push_back({ first, t + 1 - first, 0.0f });
+                first = t + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+        // a tail that never reached the target joins the cluster before it
+        if (first < end)
+        {
+            if (clusters.size() > runClusters)
+                clusters.back().triangleCount += end - first;
+            else
+                clusters.push_back({ first, end - first, 0.0f });
+        }
+    }
+
+    // area weighted centroid and normal of the mesh and of every cluster
+    vector<glm::vec3> centroids(clusters.size());
+    vector<glm::vec3> normals(clusters.size());
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++)
+        {
+            const glm::vec3& p0 = vertices[indices[t * 3]].Position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(cross);
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        normals[c] = normal;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // clusters facing away from the middle of the mesh are the ones likely to be in front, draw them first
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        float length = glm::length(normals[c]);
+        clusters[c].sortKey = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    for (const Cluster& cluster : clusters)
+        result.insert(result.end(), indices + cluster.firstTriangle * 3, indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void OptimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices) {
+    vector<unsigned int> remap(vertices.size(), UNUSED_VERTEX);
+    vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == UNUSED_VERTEX)
+        {
+            remap[index] = (unsigned int)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    for (size_t v = 0; v < vertices.size(); v++)
+        if (remap[v] == UNUSED_VERTEX)
+            reordered.push_back(vertices[v]);
+    vertices.swap(reordered);
+}
+
+void OptimizeMesh(MeshData& mesh, VertexCacheStats& before, VertexCacheStats& after) {
+    before = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+
+    vector<size_t> clusterStarts;
+    OptimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(), &clusterStarts);
+    OptimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size(), clusterStarts);
+    OptimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    after = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+}
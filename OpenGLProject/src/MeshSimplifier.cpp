@@ -0,0 +1,311 @@
+#include <lib/MeshSimplifier.h>
+
+#include <lib/MeshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+    // collapses that would turn a triangle more than about 75 degrees are rejected
+    const float MAX_NORMAL_CHANGE_COS = 0.25f;
+
+    // symmetric 4x4 matrix of a sum of squared distances to planes, weighted by triangle area
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        void addPlane(const glm::dvec3& normal, double distance, double planeWeight) {
+            a00 += planeWeight * normal.x * normal.x;
+            a01 += planeWeight * normal.x * normal.y;
+            a02 += planeWeight * normal.x * normal.z;
+            a11 += planeWeight * normal.y * normal.y;
+            a12 += planeWeight * normal.y * normal.z;
+            a22 += planeWeight * normal.z * normal.z;
+            b0 += planeWeight * normal.x * distance;
+            b1 += planeWeight * normal.y * distance;
+            b2 += planeWeight * normal.z * distance;
+            c += planeWeight * distance * distance;
+            weight += planeWeight;
+        }
+
+        Quadric& operator+=(const Quadric& other) {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02;
+            a11 += other.a11; a12 += other.a12; a22 += other.a22;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+            return *this;
+        }
+
+        // area weighted mean squared distance of point to the planes
+        double error(const glm::vec3& point) const {
+            double x = point.x, y = point.y, z = point.z;
+            double sum = a00 * x * x + a11 * y * y + a22 * z * z
+                + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+            return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+        }
+    };
+
+    const unsigned int NO_VERTEX = ~0u;
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    uint64_t edgeKey(unsigned int a, unsigned int b) {
+        return ((uint64_t)a << 32) | b;
+    }
+
+    // same id for every vertex at one position, so seams can be told apart from real borders
+    vector<unsigned int> positionIds(const Vertex* vertices, size_t vertexCount, vector<unsigned int>& sharing) {
+        struct PositionHash {
+            size_t operator()(const glm::vec3& p) const {
+                uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+                return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+            }
+        };
+        unordered_map<glm::vec3, unsigned int, PositionHash> firstAt;
+        firstAt.reserve(vertexCount);
+        vector<unsigned int> ids(vertexCount);
+        sharing.assign(vertexCount, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            ids[v] = firstAt.emplace(vertices[v].Position, (unsigned int)v).first->second;
+            sharing[ids[v]]++;
+        }
+        return ids;
+    }
+
+}
+
+float SimplifyMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount,
+    size_t targetIndexCount, vector<unsigned int>& result) {
+    result.assign(indices, indices + indexCount / 3 * 3);
+    if (result.size() <= targetIndexCount)
+        return 0.0f;
+
+    // a vertex sharing its position with exactly one other sits on a simple seam and moves together with its partner;
+    // corners where more seams meet stay put, as do vertices on edges only one triangle uses
+    vector<unsigned int> sharing;
+    vector<unsigned int> ids = positionIds(vertices, vertexCount, sharing);
+    vector<unsigned int> partner(vertexCount, NO_VERTEX);
+    vector<bool> locked(vertexCount, false);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        if (sharing[ids[v]] > 2)
+            locked[v] = true;
+        else if (sharing[ids[v]] == 2 && ids[v] != v)
+        {
+            partner[v] = ids[v];
+            partner[ids[v]] = (unsigned int)v;
+        }
+    }
+    unordered_set<uint64_t> halfEdges;
+    halfEdges.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3)
+        for (int e = 0; e < 3; e++)
+            halfEdges.insert(edgeKey(ids[result[i + e]], ids[result[i + (e + 1) % 3]]));
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            unsigned int a = result[i + e], b = result[i + (e + 1) % 3];
+            if (!halfEdges.count(edgeKey(ids[b], ids[a])))
+                locked[a] = locked[b] = true;
+        }
+    }
+    for (size_t v = 0; v < vertexCount; v++)
+        if (partner[v] != NO_VERTEX && (locked[v] || locked[partner[v]]))
+            locked[v] = locked[partner[v]] = true;
+
+    // one quadric per position, shared by the vertices on both sides of a seam
+    vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        glm::dvec3 p0 = vertices[result[i]].Position, p1 = vertices[result[i + 1]].Position, p2 = vertices[result[i + 2]].Position;
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double area = glm::length(normal);
+        if (area <= 0.0)
+            continue;
+        normal /= area;
+        Quadric plane;
+        plane.addPlane(normal, -glm::dot(normal, p0), area);
+        for (int corner = 0; corner < 3; corner++)
+            quadrics[ids[result[i + corner]]] += plane;
+    }
+
+    double maxCost = 0.0;
+    vector<unsigned int> remap(vertexCount);
+    vector<size_t> offsets(vertexCount + 1);
+    vector<unsigned int> adjacency;
+    vector<bool> touched(vertexCount);
+    vector<Collapse> collapses;
+
+    // true if moving from onto to turns one of from's remaining triangles too far, counts the indices it removes
+    auto flips = [&](unsigned int from, unsigned int to, size_t& removed) {
+        const glm::vec3& target = vertices[to].Position;
+        for (size_t a = offsets[from]; a < offsets[from + 1]; a++)
+        {
+            const unsigned int* triangle = &result[adjacency[a] * 3];
+            if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            {
+                removed += 3;
+                continue;
+            }
+            glm::vec3 before[3], after[3];
+            for (int corner = 0; corner < 3; corner++)
+            {
+                before[corner] = vertices[triangle[corner]].Position;
+                after[corner] = triangle[corner] == from ? target : before[corner];
+            }
+            glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+            if (!(glm::dot(normalBefore, normalAfter) > MAX_NORMAL_CHANGE_COS * lengths))
+                return true;
+        }
+        return false;
+    };
+
+    auto touchRing = [&](unsigned int vertex) {
+        for (size_t a = offsets[vertex]; a < offsets[vertex + 1]; a++)
+            for (int corner = 0; corner < 3; corner++)
+                touched[result[adjacency[a] * 3 + corner]] = true;
+    };
+
+    while (result.size() > targetIndexCount)
+    {
+        // triangles around each vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (unsigned int index : result)
+            offsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+
+        // every collapse of a free vertex along one of its edges
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    unsigned int from = result[i + (direction ? (e + 1) % 3 : e)];
+                    unsigned int to = result[i + (direction ? e : (e + 1) % 3)];
+                    if (locked[from])
+                        continue;
+                    Quadric merged = quadrics[ids[from]];
+                    merged += quadrics[ids[to]];
+                    collapses.push_back({ from, to, merged.error(vertices[to].Position) });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost || (a.cost == b.cost && (a.from < b.from || (a.from == b.from && a.to < b.to)));
+        });
+
+        // apply them cheapest first; a collapse changes the whole ring around its vertex, so the ring sits out
+        // the rest of the pass
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            remap[v] = (unsigned int)v;
+            touched[v] = false;
+        }
+        size_t removedIndices = 0;
+        size_t applied = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (result.size() - removedIndices <= targetIndexCount)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // the other side of a seam has to follow along the seam, onto the vertex at the target position next to it
+            unsigned int otherFrom = partner[collapse.from];
+            unsigned int otherTo = NO_VERTEX;
+            if (otherFrom != NO_VERTEX)
+            {
+                for (size_t a = offsets[otherFrom]; a < offsets[otherFrom + 1]; a++)
+                    for (int corner = 0; corner < 3; corner++)
+                        if (ids[result[adjacency[a] * 3 + corner]] == ids[collapse.to])
+                            otherTo = result[adjacency[a] * 3 + corner];
+                if (otherTo == NO_VERTEX || otherTo == collapse.to || touched[otherFrom] || touched[otherTo])
+                    continue;
+            }
+
+            size_t removed = 0;
+            if (flips(collapse.from, collapse.to, removed) || (otherFrom != NO_VERTEX && flips(otherFrom, otherTo, removed)))
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            touchRing(collapse.from);
+            if (otherFrom != NO_VERTEX)
+            {
+                remap[otherFrom] = otherTo;
+                touchRing(otherFrom);
+            }
+            quadrics[ids[collapse.to]] += quadrics[ids[collapse.from]];
+            maxCost = std::max(maxCost, collapse.cost);
+            removedIndices += removed;
+            applied++;
+        }
+        if (applied == 0)
+            break;
+
+        // rewrite the triangles and drop the ones that collapsed to a line
+        size_t kept = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+    }
+
+    return (float)std::sqrt(maxCost);
+}
+
+void BuildMeshLods(MeshData& mesh) {
+    size_t fullIndexCount = mesh.indices.size();
+    mesh.lods.assign(1, { 0, fullIndexCount, 0.0f });
+
+    vector<unsigned int> simplified;
+    size_t previousCount = fullIndexCount;
+    float previousError = 0.0f;
+    for (size_t level = 1; level < MAX_MESH_LODS; level++)
+    {
+        size_t target = (size_t)(previousCount / 3 * MESH_LOD_REDUCTION) * 3;
+        if (target < MIN_LOD_TRIANGLES * 3)
+            break;
+
+        float error = SimplifyMesh(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), fullIndexCount, target, simplified);
+        // stop once the locked vertices keep a level from getting meaningfully smaller
+        if (simplified.size() > previousCount * 0.9f)
+            break;
+
+        OptimizeVertexCache(simplified.data(), simplified.size(), mesh.vertices.size());
+        previousError = std::max(previousError, error);
+        mesh.lods.push_back({ mesh.indices.size(), simplified.size(), previousError });
+        mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+        previousCount = simplified.size();
+    }
+}
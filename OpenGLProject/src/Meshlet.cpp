@@ -0,0 +1,225 @@
+#include <lib/Meshlet.h>
+#include <lib/MeshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    const size_t NOT_IN_MESHLET = ~(size_t)0;
+    // how much a new vertex weighs against bending the normal cone when picking the next triangle
+    const float MESHLET_CONE_WEIGHT = 2.0f;
+    // a neighbour whose normal is more than about 45 degrees off the meshlet's average doesn't join it; tighter cones
+    // cull more often, at the price of smaller meshlets on coarse meshes
+    const float MESHLET_MIN_ALIGNMENT = 0.7f;
+
+    // bounds of the triangles [firstIndex, firstIndex + indexCount) of a mesh
+    Meshlet boundMeshlet(const MeshData& mesh, size_t firstIndex, size_t indexCount) {
+        Meshlet meshlet;
+        meshlet.firstIndex = firstIndex;
+        meshlet.indexCount = indexCount;
+
+        glm::vec3 low = mesh.vertices[mesh.indices[firstIndex]].Position;
+        glm::vec3 high = low;
+        for (size_t i = firstIndex; i < firstIndex + indexCount; i++)
+        {
+            low = glm::min(low, mesh.vertices[mesh.indices[i]].Position);
+            high = glm::max(high, mesh.vertices[mesh.indices[i]].Position);
+        }
+        meshlet.center = (low + high) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (size_t i = firstIndex; i < firstIndex + indexCount; i++)
+            meshlet.radius = std::max(meshlet.radius, glm::length(mesh.vertices[mesh.indices[i]].Position - meshlet.center));
+
+        // the cone holds every triangle normal; its axis is their average and the cutoff the sine of its half angle
+        glm::vec3 normalSum(0.0f);
+        vector<glm::vec3> normals;
+        normals.reserve(indexCount / 3);
+        for (size_t i = firstIndex; i + 3 <= firstIndex + indexCount; i += 3)
+        {
+            const glm::vec3& p0 = mesh.vertices[mesh.indices[i]].Position;
+            const glm::vec3& p1 = mesh.vertices[mesh.indices[i + 1]].Position;
+            const glm::vec3& p2 = mesh.vertices[mesh.indices[i + 2]].Position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+                continue;
+            normals.push_back(normal / length);
+            normalSum += normal / length;
+        }
+
+        float sumLength = glm::length(normalSum);
+        meshlet.coneAxis = sumLength > 0.0f ? normalSum / sumLength : glm::vec3(0.0f, 0.0f, 1.0f);
+        float minimumDot = sumLength > 0.0f ? 1.0f : -1.0f;
+        for (const glm::vec3& normal : normals)
+            minimumDot = std::min(minimumDot, glm::dot(meshlet.coneAxis, normal));
+        // a cone of 90 degrees or more faces some viewer everywhere, a cutoff above 1 never culls
+        meshlet.coneCutoff = minimumDot <= 0.0f ? 2.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+        return meshlet;
+    }
+
+}
+
+void BuildMeshlets(MeshData& mesh) {
+    mesh.meshlets.clear();
+    if (mesh.lods.empty() || mesh.lods[0].indexCount < MIN_MESHLETS * MESHLET_MAX_TRIANGLES * 3)
+        return;
+
+    size_t firstIndex = mesh.lods[0].firstIndex;
+    size_t triangleCount = mesh.lods[0].indexCount / 3;
+    const unsigned int* triangles = &mesh.indices[firstIndex];
+
+    // unit normals, and the triangles around each vertex
+    vector<glm::vec3> normals(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& p0 = mesh.vertices[triangles[t * 3]].Position;
+        const glm::vec3& p1 = mesh.vertices[triangles[t * 3 + 1]].Position;
+        const glm::vec3& p2 = mesh.vertices[triangles[t * 3 + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+    vector<size_t> offsets(mesh.vertices.size() + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        offsets[triangles[i] + 1]++;
+    for (size_t v = 0; v < mesh.vertices.size(); v++)
+        offsets[v + 1] += offsets[v];
+    vector<unsigned int> adjacency(triangleCount * 3);
+    vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[triangles[i]]++] = (unsigned int)(i / 3);
+
+    // grow each meshlet from the first triangle left in cache order, always adding the neighbour that needs the fewest
+    // new vertices and bends its normal cone the least; a neighbour that would open the cone too far ends it early
+    vector<bool> emitted(triangleCount, false);
+    vector<size_t> localIndex(mesh.vertices.size(), NOT_IN_MESHLET);
+    vector<unsigned int> meshletVertices, meshletTriangles, candidates;
+    vector<vector<unsigned int>> built;
+    size_t seed = 0;
+    while (true)
+    {
+        while (seed < triangleCount && emitted[seed])
+            seed++;
+        if (seed == triangleCount)
+            break;
+
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        glm::vec3 normalSum(0.0f);
+        size_t next = seed;
+        while (next != NOT_IN_MESHLET)
+        {
+            emitted[next] = true;
+            meshletTriangles.push_back((unsigned int)next);
+            normalSum += normals[next];
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int vertex = triangles[next * 3 + corner];
+                if (localIndex[vertex] != NOT_IN_MESHLET)
+                    continue;
+                localIndex[vertex] = meshletVertices.size();
+                meshletVertices.push_back(vertex);
+                for (size_t a = offsets[vertex]; a < offsets[vertex + 1]; a++)
+                    if (!emitted[adjacency[a]])
+                        candidates.push_back(adjacency[a]);
+            }
+            if (meshletTriangles.size() == MESHLET_MAX_TRIANGLES)
+                break;
+
+            glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+            next = NOT_IN_MESHLET;
+            float bestScore = 0.0f;
+            size_t kept = 0;
+            for (unsigned int candidate : candidates)
+            {
+                if (emitted[candidate])
+                    continue;
+                candidates[kept++] = candidate;
+                size_t newVertices = 0;
+                for (int corner = 0; corner < 3; corner++)
+                    if (localIndex[triangles[candidate * 3 + corner]] == NOT_IN_MESHLET)
+                        newVertices++;
+                float alignment = glm::dot(axis, normals[candidate]);
+                if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES || alignment < MESHLET_MIN_ALIGNMENT)
+                    continue;
+                float score = newVertices + MESHLET_CONE_WEIGHT * (1.0f - alignment);
+                if (next == NOT_IN_MESHLET || score < bestScore)
+                {
+                    bestScore = score;
+                    next = candidate;
+                }
+            }
+            candidates.resize(kept);
+        }
+
+        for (unsigned int vertex : meshletVertices)
+            localIndex[vertex] = NOT_IN_MESHLET;
+        candidates.clear();
+        built.push_back(meshletTriangles);
+    }
+
+    // meshlets in the order their seeds had, which follows the cache optimized order, each reordered for the cache
+    // on its own
+    vector<unsigned int> reordered;
+    reordered.reserve(triangleCount * 3);
+    for (const vector<unsigned int>& meshletTriangles : built)
+    {
+        size_t first = reordered.size();
+        for (unsigned int triangle : meshletTriangles)
+            reordered.insert(reordered.end(), triangles + triangle * 3, triangles + triangle * 3 + 3);
+
+        meshletVertices.clear();
+        for (size_t i = first; i < reordered.size(); i++)
+        {
+            if (localIndex[reordered[i]] == NOT_IN_MESHLET)
+            {
+                localIndex[reordered[i]] = meshletVertices.size();
+                meshletVertices.push_back(reordered[i]);
+            }
+            reordered[i] = (unsigned int)localIndex[reordered[i]];
+        }
+        OptimizeVertexCache(&reordered[first], reordered.size() - first, meshletVertices.size());
+        for (size_t i = first; i < reordered.size(); i++)
+            reordered[i] = meshletVertices[reordered[i]];
+        for (unsigned int vertex : meshletVertices)
+            localIndex[vertex] = NOT_IN_MESHLET;
+    }
+    std::copy(reordered.begin(), reordered.end(), mesh.indices.begin() + firstIndex);
+
+    size_t first = firstIndex;
+    for (const vector<unsigned int>& meshletTriangles : built)
+    {
+        mesh.meshlets.push_back(boundMeshlet(mesh, first, meshletTriangles.size() * 3));
+        first += meshletTriangles.size() * 3;
+    }
+}
+
+void ExtractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]) {
+    glm::vec4 rows[4];
+    for (int row = 0; row < 4; row++)
+        rows[row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+
+    // left, right, bottom, top, near, far
+    for (int axis = 0; axis < 3; axis++)
+    {
+        planes[axis * 2] = rows[3] + rows[axis];
+        planes[axis * 2 + 1] = rows[3] - rows[axis];
+    }
+    for (int plane = 0; plane < 6; plane++)
+    {
+        float length = glm::length(glm::vec3(planes[plane]));
+        if (length > 0.0f)
+            planes[plane] /= length;
+    }
+}
+
+bool IsMeshletVisible(const Meshlet& meshlet, const glm::vec3& viewer, const glm::vec4 planes[6]) {
+    for (int plane = 0; plane < 6; plane++)
+        if (glm::dot(glm::vec3(planes[plane]), meshlet.center) + planes[plane].w < -meshlet.radius)
+            return false;
+
+    // back facing if the direction to the cluster stays within the cone's complement from every point of the sphere
+    glm::vec3 toCenter = meshlet.center - viewer;
+    return glm::dot(toCenter, meshlet.coneAxis) < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
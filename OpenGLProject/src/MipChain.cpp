@@ -0,0 +1,221 @@
+#include <lib/MipChain.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    // Kaiser filter support in target pixels and its shape parameter
+    const double KAISER_WIDTH = 3.0;
+    const double KAISER_ALPHA = 4.0;
+    const double PI = 3.14159265358979323846;
+
+    // weights of one axis of a separable filter: every target pixel reads taps source pixels,
+    // with the source indices already clamped to the image
+    struct AxisFilter {
+        int taps;
+        std::vector<int> indices;
+        std::vector<float> weights;
+    };
+
+    // modified Bessel function of the first kind, order 0
+    double besselI0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; k++)
+        {
+            double factor = x / (2.0 * k);
+            term *= factor * factor;
+            sum += term;
+            if (term < sum * 1e-12)
+                break;
+        }
+        return sum;
+    }
+
+    double kaiserWindowedSinc(double x) {
+        if (std::fabs(x) >= KAISER_WIDTH)
+            return 0.0;
+        double ratio = x / KAISER_WIDTH;
+        double window = besselI0(KAISER_ALPHA * std::sqrt(1.0 - ratio * ratio)) / besselI0(KAISER_ALPHA);
+        double sinc = x == 0.0 ? 1.0 : std::sin(PI * x) / (PI * x);
+        return sinc * window;
+    }
+
+    AxisFilter buildKaiserFilter(int sourceSize, int targetSize) {
+        double scale = (double)sourceSize / targetSize;
+        double radius = KAISER_WIDTH * scale;
+
+        AxisFilter filter;
+        filter.taps = (int)std::ceil(2.0 * radius) + 1;
+        filter.indices.resize((size_t)targetSize * filter.taps);
+        filter.weights.resize((size_t)targetSize * filter.taps);
+        for (int target = 0; target < targetSize; target++)
+        {
+            double center = (target + 0.5) * scale;
+            int first = (int)std::floor(center - radius);
+            double sum = 0.0;
+            for (int k = 0; k < filter.taps; k++)
+            {
+                double weight = kaiserWindowedSinc((first + k + 0.5 - center) / scale);
+                filter.indices[target * filter.taps + k] = std::min(std::max(first + k, 0), sourceSize - 1);
+                filter.weights[target * filter.taps + k] = (float)weight;
+                sum += weight;
+            }
+            for (int k = 0; k < filter.taps; k++)
+                filter.weights[target * filter.taps + k] = (float)(filter.weights[target * filter.taps + k] / sum);
+        }
+        return filter;
+    }
+
+    MipLevel allocateLevel(const MipLevel& source) {
+        MipLevel level;
+        level.width = std::max(source.width / 2, 1);
+        level.height = std::max(source.height / 2, 1);
+        level.pixels.resize((size_t)level.width * level.height * 4);
+        return level;
+    }
+
+    void boxPixel(const unsigned char* row0, const unsigned char* row1, int x0, int x1, unsigned char* out) {
+        for (int c = 0; c < 4; c++)
+            out[c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+    }
+
+    MipLevel downsampleBox(const MipLevel& source) {
+        MipLevel level = allocateLevel(source);
+        for (int y = 0; y < level.height; y++)
+        {
+            const unsigned char* row0 = &source.pixels[(size_t)std::min(2 * y, source.height - 1) * source.width * 4];
+            const unsigned char* row1 = &source.pixels[(size_t)std::min(2 * y + 1, source.height - 1) * source.width * 4];
+            unsigned char* out = &level.pixels[(size_t)y * level.width * 4];
+
+            int x = 0;
+#ifdef MIP_CHAIN_SSE2
+            // two target pixels from 4 source pixels of both rows per iteration, summed in 16 bits
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i rounding = _mm_set1_epi16(2);
+            for (; 2 * x + 3 < source.width && x + 1 < level.width; x += 2)
+            {
+                __m128i top = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+                __m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+                __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+                __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+                left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+                right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+                __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(left, right), rounding), 2);
+                _mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, sum));
+            }
+#endif
+            for (; x < level.width; x++)
+                boxPixel(row0, row1, std::min(2 * x, source.width - 1) * 4, std::min(2 * x + 1, source.width - 1) * 4, out + x * 4);
+        }
+        return level;
+    }
+
+#ifdef MIP_CHAIN_SSE2
+    __m128 loadPixel(const unsigned char* pixel) {
+        int packed;
+        std::memcpy(&packed, pixel, sizeof(packed));
+        __m128i zero = _mm_setzero_si128();
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero));
+    }
+
+    void storePixel(__m128 value, unsigned char* pixel) {
+        value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+        __m128i rounded = _mm_cvtps_epi32(value);
+        rounded = _mm_packs_epi32(rounded, rounded);
+        int packed = _mm_cvtsi128_si32(_mm_packus_epi16(rounded, rounded));
+        std::memcpy(pixel, &packed, sizeof(packed));
+    }
+#endif
+
+    // separable Kaiser filter: a horizontal pass into floats, then a vertical pass back to 8 bits.
+    // Every pixel is processed as one 4 float vector.
+    MipLevel downsampleKaiser(const MipLevel& source) {
+        MipLevel level = allocateLevel(source);
+        AxisFilter horizontal = buildKaiserFilter(source.width, level.width);
+        AxisFilter vertical = buildKaiserFilter(source.height, level.height);
+
+        std::vector<float> filtered((size_t)level.width * source.height * 4);
+        std::vector<float> accumulator((size_t)level.width * 4);
+        for (int y = 0; y < source.height; y++)
+        {
+            const unsigned char* row = &source.pixels[(size_t)y * source.width * 4];
+            float* out = &filtered[(size_t)y * level.width * 4];
+            for (int x = 0; x < level.width; x++)
+            {
+                const int* indices = &horizontal.indices[(size_t)x * horizontal.taps];
+                const float* weights = &horizontal.weights[(size_t)x * horizontal.taps];
+#ifdef MIP_CHAIN_SSE2
+                __m128 sum = _mm_setzero_ps();
+                for (int k = 0; k < horizontal.taps; k++)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), loadPixel(row + indices[k] * 4)));
+                _mm_storeu_ps(out + x * 4, sum);
+#else
+                for (int c = 0; c < 4; c++)
+                {
+                    float sum = 0.0f;
+                    for (int k = 0; k < horizontal.taps; k++)
+                        sum += weights[k] * row[indices[k] * 4 + c];
+                    out[x * 4 + c] = sum;
+                }
+#endif
+            }
+        }
+
+        // rows are accumulated whole so the vertical pass walks memory linearly
+        for (int y = 0; y < level.height; y++)
+        {
+            std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+            for (int k = 0; k < vertical.taps; k++)
+            {
+                float weight = vertical.weights[(size_t)y * vertical.taps + k];
+                const float* row = &filtered[(size_t)vertical.indices[(size_t)y * vertical.taps + k] * level.width * 4];
+#ifdef MIP_CHAIN_SSE2
+                __m128 scale = _mm_set1_ps(weight);
+                for (size_t i = 0; i < accumulator.size(); i += 4)
+                    _mm_storeu_ps(&accumulator[i], _mm_add_ps(_mm_loadu_ps(&accumulator[i]), _mm_mul_ps(scale, _mm_loadu_ps(row + i))));
+#else
+                for (size_t i = 0; i < accumulator.size(); i++)
+                    accumulator[i] += weight * row[i];
+#endif
+            }
+
+            unsigned char* out = &level.pixels[(size_t)y * level.width * 4];
+#ifdef MIP_CHAIN_SSE2
+            for (int x = 0; x < level.width; x++)
+                storePixel(_mm_loadu_ps(&accumulator[(size_t)x * 4]), out + x * 4);
+#else
+            for (size_t i = 0; i < accumulator.size(); i++)
+                out[i] = (unsigned char)std::lrint(std::min(std::max(accumulator[i], 0.0f), 255.0f));
+#endif
+        }
+        return level;
+    }
+
+}
+
+MipLevelView MipLevel::View() const {
+    MipLevelView view;
+    view.width = width;
+    view.height = height;
+    view.pixels = pixels.data();
+    return view;
+}
+
+std::vector<MipLevel> BuildMipChain(const unsigned char* rgba, int width, int height, MipFilter filter) {
+    std::vector<MipLevel> chain(1);
+    chain[0].width = width;
+    chain[0].height = height;
+    chain[0].pixels.assign(rgba, rgba + (size_t)width * height * 4);
+
+    while (chain.back().width > 1 || chain.back().height > 1)
+        chain.push_back(filter == MIP_FILTER_KAISER ? downsampleKaiser(chain.back()) : downsampleBox(chain.back()));
+    return chain;
+}
@@ -1,212 +1,324 @@
 #include <lib/Model.h>
 
-Model::Model(string const& path, bool gamma) : gammaCorrection(gamma)
+Model::Model(string const& path, bool gamma, MeshResidency residency, ImportProfile profile, const Shader* shader)
+    : gammaCorrection(gamma), meshletCulling(true), residency(residency), importProfile(profile), vertexStreams(VERTEX_STREAMS_ALL), boundsMin(0.0f), boundsMax(0.0f),
+    ready(false), boundsKnown(false), streamed(false), contentsVersion(0), textureGeneration(TextureRegistry::Instance().Generation()),
+    loadAllTextures(true)
 {
+    setTargetShader(shader);
     loadModel(path);
 }
 
+Model::Model() : gammaCorrection(false), meshletCulling(true), residency(MESH_RESIDENCY_KEEP), importProfile(IMPORT_PROFILE_RUNTIME), vertexStreams(VERTEX_STREAMS_ALL),
+    boundsMin(0.0f), boundsMax(0.0f), ready(false), boundsKnown(false), streamed(false), contentsVersion(0),
+    textureGeneration(TextureRegistry::Instance().Generation()), loadAllTextures(true)
+{
+}
+
+Model::~Model()
+{
+    refreshTextureSlots();
+    for (size_t i = 0; i < textures_loaded.size(); i++)
+    {
+        const Texture& texture = textures_loaded[i];
+        // deferred textures hold no reference, neither do ones that failed to load
+        if (deferredTextures.count(i) || texture.id == 0)
+            continue;
+        if (texture.isVirtual)
+        {
+            VirtualTextureCache::Instance().Release(texture.id);
+            continue;
+        }
+        TextureRegistry::Instance().Release(sourceOf(texture));
+    }
+}
+
 void Model::Draw(Shader& shader)
 {
+    if (!ready)
+        return;
+    requestSampledTextures(shader);
+    refreshTextureSlots();
+    Mesh::ResetBoundTextures();
     for (unsigned int i = 0; i < meshes.size(); i++)
         meshes[i].Draw(shader);
 }
 
+size_t Model::Draw(Shader& shader, const glm::mat4& modelMatrix, const glm::mat4& viewProjection, const Camera& camera, float viewportHeight, float maxPixelError)
+{
+    if (!ready)
+        return 0;
+    requestSampledTextures(shader);
+    refreshTextureSlots();
+    Mesh::ResetBoundTextures();
+
+    // one scale for the whole model, taken at its center and along its most stretched axis
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+    float pixelsPerUnit = camera.PixelsPerUnit(center, viewportHeight) * scale;
+
+    // meshlets are culled in object space
+    glm::vec4 planes[6];
+    ExtractFrustumPlanes(viewProjection * modelMatrix, planes);
+    glm::vec3 viewer = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(camera.Position, 1.0f));
+
+    size_t triangles = 0;
+    for (Mesh& mesh : meshes)
+    {
+        size_t lod = mesh.SelectLod(pixelsPerUnit, maxPixelError);
+        if (lod == 0 && meshletCulling)
+        {
+            triangles += mesh.DrawVisibleMeshlets(shader, viewer, planes);
+        }
+        else
+        {
+            mesh.Draw(shader, lod);
+            triangles += mesh.lods[lod].indexCount / 3;
+        }
+    }
+    return triangles;
+}
+
 void Model::SetShaderTextureNamePrefix(std::string prefix) {
+    textureNamePrefix = prefix;
     for (Mesh& mesh : meshes) {
         mesh.glslIdentifierPrefix = prefix;
     }
+    // the deferred textures are sampled under other names now
+    checkedPrograms.clear();
 }
 
-void Model::loadModel(string const& path) {
-    // read file via ASSIMP
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-    // check for errors
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+bool Model::IsReady() const {
+    return ready;
+}
+
+bool Model::HasBounds() const {
+    return boundsKnown;
+}
+
+Model::MemoryStats Model::GetMemoryStats() const {
+    MemoryStats stats = { 0, 0 };
+    for (const Mesh& mesh : meshes)
     {
-        cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-        return;
+        stats.cpuBytes += mesh.CpuBytes();
+        stats.gpuBytes += mesh.GpuBytes();
     }
+    // several textures are usually layers of one array
+    std::unordered_set<unsigned int> arrays;
+    for (const Texture& texture : textures_loaded)
+        if (arrays.insert(texture.id).second)
+            stats.gpuBytes += TextureRegistry::Instance().TextureBytes(texture.id);
+    return stats;
+}
+
+void Model::loadModel(string const& path) {
     // retrieve the directory path of the filepath
     directory = path.substr(0, path.find_last_of('/'));
 
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
-}
+    ModelImport import;
+    if (!ImportModel(path, ImportFlagsFor(importProfile), import))
+        return;
+    boundsMin = import.boundsMin;
+    boundsMax = import.boundsMax;
+    boundsKnown = true;
+    sourceFiles = import.sourceFiles;
 
-void Model::processNode(aiNode* node, const aiScene* scene) {
-    // process each mesh located at the current node
-    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    meshes.reserve(import.meshes.size());
+    for (size_t i = 0; i < import.meshes.size(); i++)
     {
-        // the node object only contains indices to index the actual objects in the scene.
-        // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        resolveTextures(import.meshes[i]);
+        uploadMesh(import, i);
     }
-    // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-    for (unsigned int i = 0; i < node->mNumChildren; i++)
+    loadPendingTextures();
+    ready = true;
+}
+
+void Model::resolveTextures(MeshView& view) {
+    for (size_t i = 0; i < view.textures.size(); i++)
     {
-        processNode(node->mChildren[i], scene);
+        bool sampled = loadAllTextures || loadSamplers.count(Mesh::SamplerName(view.textures, i, textureNamePrefix)) != 0;
+        view.textures[i] = loadMaterialTexture(view.textures[i].path, view.textures[i].type, sampled);
     }
-
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
-    // data to fill
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
+void Model::setTargetShader(const Shader* shader) {
+    loadAllTextures = shader == nullptr;
+    loadSamplers.clear();
+    vertexStreams = VERTEX_STREAMS_ALL;
+    if (shader)
+    {
+        loadSamplers = shader->GetActiveSamplers();
+        vertexStreams = VertexStreamsFor(*shader);
+    }
+}
 
-    // walk through each of the mesh's vertices
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+void Model::requestSampledTextures(Shader& shader) {
+    if (!deferredTextures.empty() && checkedPrograms.insert(shader.GetID()).second)
     {
-        Vertex vertex;
-        glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-        // positions
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.Position = vector;
-        // normals
-        if (mesh->HasNormals())
-        {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.Normal = vector;
-        }
-        // texture coordinates
-        if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+        bool acquired = false;
+        for (const Mesh& mesh : meshes)
         {
-            glm::vec2 vec;
-            // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
-            // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.TexCoords = vec;
-            // tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.Tangent = vector;
-            // bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.Bitangent = vector;
+            for (size_t i = 0; i < mesh.textures.size(); i++)
+            {
+                size_t index = texturesLoadedIndex[loadedKeyFor(mesh.textures[i].path, mesh.textures[i].type)];
+                if (!deferredTextures.count(index) || !shader.IsSamplerActive(Mesh::SamplerName(mesh.textures, i, mesh.glslIdentifierPrefix)))
+                    continue;
+                deferredTextures.erase(index);
+                acquireTexture(index);
+                acquired = true;
+            }
         }
-        else
-            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-        vertices.push_back(vertex);
-
+        // the ones other models had loaded already
+        if (acquired)
+            syncMeshTextures();
+    }
+    // a streamed model's pending textures are picked up by its ModelStreamer::Update
+    if (!streamed && !pendingTextures.empty())
+        loadPendingTextures();
+}
 
+void Model::uploadMesh(ModelImport& import, size_t i) {
+    // freshly imported geometry is handed over to the mesh, geometry from the cache is copied out of the mapping
+    if (i < import.imported.size())
+    {
+        MeshData& data = import.imported[i];
+        data.textures = import.meshes[i].textures;
+        meshes.emplace_back(std::move(data), vertexStreams);
     }
-    // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+    else
     {
-        aiFace face = mesh->mFaces[i];
-        // retrieve all indices of the face and store them in the indices vector
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+        meshes.emplace_back(import.meshes[i], vertexStreams);
     }
-    // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-    // Same applies to other texture as the following list summarizes:
-    // diffuse: texture_diffuseN
-    // specular: texture_specularN
-    // normal: texture_normalN
-    aiColor3D color(0.0f, 0.0f, 0.0f);
-    material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-
-
-    // 1. diffuse maps
-    vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-    // 2. specular maps
-    vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-    // 3. normal maps
-    std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-    // 4. height maps
-    std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
+    meshes.back().glslIdentifierPrefix = textureNamePrefix;
+    meshes.back().SetResidency(residency);
+}
 
+void Model::refreshTextureSlots() {
+    const TextureRegistry& registry = TextureRegistry::Instance();
+    if (textureGeneration == registry.Generation())
+        return;
+    textureGeneration = registry.Generation();
+    for (Texture& texture : textures_loaded)
+    {
+        // a texture that failed to load has no slot to move, a virtual one has none at all
+        if (texture.id == 0 || texture.isVirtual)
+            continue;
+        TextureSlot slot = registry.Find(sourceOf(texture));
+        texture.id = slot.id;
+        texture.layer = slot.layer;
+    }
+    syncMeshTextures();
+}
 
-    // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+void Model::applyTextureSlots(const vector<size_t>& indices, const vector<TextureSlot>& slots) {
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        Texture& texture = textures_loaded[indices[i]];
+        texture.id = slots[i].id;
+        texture.layer = slots[i].layer;
+    }
+    syncMeshTextures();
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) {
-    vector<Texture> textures;
-    for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+void Model::syncMeshTextures() {
+    for (Mesh& mesh : meshes)
     {
-        aiString str;
-        mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        for (Texture& texture : mesh.textures)
         {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
-        }
-        if (!skip)
-        {   // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+            const Texture& loaded = textures_loaded[texturesLoadedIndex[loadedKeyFor(texture.path, texture.type)]];
+            texture.id = loaded.id;
+            texture.layer = loaded.layer;
+            texture.isVirtual = loaded.isVirtual;
         }
     }
-    return textures;
 }
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
+void Model::swapContents(Model& other) {
+    // the new meshes draw with the same shader names as the old ones, the prefix may have changed during the reload
+    for (Mesh& mesh : other.meshes)
+        mesh.glslIdentifierPrefix = textureNamePrefix;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    std::swap(meshes, other.meshes);
+    std::swap(textures_loaded, other.textures_loaded);
+    std::swap(texturesLoadedIndex, other.texturesLoadedIndex);
+    std::swap(sourceFiles, other.sourceFiles);
+    std::swap(boundsMin, other.boundsMin);
+    std::swap(boundsMax, other.boundsMax);
+    std::swap(ready, other.ready);
+    std::swap(boundsKnown, other.boundsKnown);
+    std::swap(textureGeneration, other.textureGeneration);
+    std::swap(deferredTextures, other.deferredTextures);
+    std::swap(checkedPrograms, other.checkedPrograms);
+    std::swap(pendingTextures, other.pendingTextures);
+    contentsVersion++;
+    other.contentsVersion++;
+}
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+void Model::loadPendingTextures() {
+    // decode on the worker threads, then upload them into as few texture arrays as possible
+    vector<size_t> indices;
+    indices.swap(pendingTextures);
+    vector<TextureSource> sources;
+    for (size_t index : indices)
+        sources.push_back(sourceOf(textures_loaded[index]));
+    applyTextureSlots(indices, LoadTextureArrays(sources));
+}
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+TextureSource Model::sourceOf(const Texture& texture) const {
+    TextureSource source;
+    source.path = this->directory + '/' + texture.path;
+    source.usage = TextureRegistry::Usage(texture.type, gammaCorrection);
+    return source;
+}
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+string Model::loadedKeyFor(const string& path, const string& type) {
+    return path + '\n' + type;
+}
 
-        stbi_image_free(data);
+Texture Model::loadMaterialTexture(const string& path, const string& typeName, bool sampled) {
+    // check if this model uses the file as this type already and if so, reuse it; another mesh may sample what it deferred
+    string key = loadedKeyFor(path, typeName);
+    unordered_map<string, size_t>::const_iterator loaded = texturesLoadedIndex.find(key);
+    if (loaded != texturesLoadedIndex.end())
+    {
+        if (sampled && deferredTextures.erase(loaded->second))
+            acquireTexture(loaded->second);
+        return textures_loaded[loaded->second];
     }
+
+    Texture texture;
+    texture.id = 0;
+    texture.type = typeName;
+    texture.path = path;
+    size_t index = textures_loaded.size();
+    texturesLoadedIndex[key] = index;
+    textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+    if (sampled)
+        acquireTexture(index);
     else
+        deferredTextures.insert(index);
+    return textures_loaded[index];
+}
+
+void Model::acquireTexture(size_t index) {
+    // take a reference on the shared texture, it only has to be loaded if no other model had it yet
+    TextureSlot slot;
+    Texture& texture = textures_loaded[index];
+    string fullPath = this->directory + '/' + texture.path;
+    // very large diffuse maps are paged in as far as they are seen instead, see VirtualTextureCache
+    if (texture.type == "texture_diffuse" && VirtualTextureCache::Instance().ShouldPage(fullPath))
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        texture.id = VirtualTextureCache::Instance().Acquire(fullPath);
+        texture.isVirtual = texture.id != 0;
+    }
+    if (!texture.isVirtual && TextureRegistry::Instance().Acquire(sourceOf(texture), slot))
+    {
+        texture.id = slot.id;
+        texture.layer = slot.layer;
+    }
+    else if (!texture.isVirtual)
+    {
+        texture.id = 0;
+        pendingTextures.push_back(index);
     }
-
-    return textureID;
 }
@@ -0,0 +1,212 @@
+#include <lib/ModelImporter.h>
+
+#include <algorithm>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <lib/MappedIOSystem.h>
+#include <lib/MeshOptimizer.h>
+#include <lib/MeshSimplifier.h>
+#include <lib/Meshlet.h>
+
+namespace {
+
+    // collects all material textures of a given type. Only type and path are filled in,
+    // the texture ids are resolved when the mesh is uploaded.
+    vector<Texture> collectMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) {
+        vector<Texture> textures;
+        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        {
+            aiString str;
+            mat->GetTexture(type, i, &str);
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
+        return textures;
+    }
+
+    MeshData processMesh(aiMesh* mesh, const aiScene* scene) {
+        // data to fill
+        MeshData data;
+        vector<Vertex>& vertices = data.vertices;
+        vector<unsigned int>& indices = data.indices;
+        vector<Texture>& textures = data.textures;
+        data.boundsMin = glm::vec3(0.0f);
+        data.boundsMax = glm::vec3(0.0f);
+
+        // size everything up front and convert each vertex in place
+        vertices.resize(mesh->mNumVertices);
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            Vertex& vertex = vertices[i];
+            // positions
+            vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            data.boundsMin = i == 0 ? vertex.Position : glm::min(data.boundsMin, vertex.Position);
+            data.boundsMax = i == 0 ? vertex.Position : glm::max(data.boundsMax, vertex.Position);
+            // normals
+            vertex.Normal = mesh->HasNormals() ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f);
+            // texture coordinates
+            if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            {
+                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
+                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+            }
+            else
+                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            // tangent frame, only if the import profile asked for it
+            if (mesh->HasTangentsAndBitangents())
+            {
+                vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+                vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+            }
+            else
+            {
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
+        }
+        data.vertexFormat = ChooseVertexFormat(vertices.data(), vertices.size(), data.boundsMin, data.boundsMax);
+        // now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        size_t indexCount = 0;
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+            indexCount += mesh->mFaces[i].mNumIndices;
+        indices.resize(indexCount);
+        unsigned int* index = indices.data();
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace& face = mesh->mFaces[i];
+            // retrieve all indices of the face and store them in the indices vector
+            index = std::copy(face.mIndices, face.mIndices + face.mNumIndices, index);
+        }
+        // process materials
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
+        // Same applies to other texture as the following list summarizes:
+        // diffuse: texture_diffuseN
+        // specular: texture_specularN
+        // normal: texture_normalN
+        aiColor3D color(0.0f, 0.0f, 0.0f);
+        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
+
+
+        // 1. diffuse maps
+        vector<Texture> diffuseMaps = collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        // 2. specular maps
+        vector<Texture> specularMaps = collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        // 3. normal maps
+        std::vector<Texture> normalMaps = collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        // 4. height maps
+        std::vector<Texture> heightMaps = collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+
+
+
+        // return the extracted mesh data, it is uploaded once the whole model is imported
+        return data;
+    }
+
+    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(aiNode* node, const aiScene* scene, vector<MeshData>& meshData) {
+        // process each mesh located at the current node
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        {
+            // the node object only contains indices to index the actual objects in the scene.
+            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+            meshData.push_back(processMesh(mesh, scene));
+        }
+        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+        {
+            processNode(node->mChildren[i], scene, meshData);
+        }
+
+    }
+
+}
+
+bool ImportModel(const string& path, unsigned int importFlags, ModelImport& result, bool useCache, std::ostream& log) {
+    // warm start: reuse the geometry imported by a previous run if the source hasn't changed since
+    if (useCache && result.cache.Open(path, importFlags))
+    {
+        result.meshes = result.cache.Entries();
+        result.sourceFiles.push_back(path);
+        result.sourceFiles.insert(result.sourceFiles.end(), result.cache.Dependencies().begin(), result.cache.Dependencies().end());
+    }
+    else
+    {
+        // read file via ASSIMP, from mapped pages; the importer owns the IO system and also opens material libraries
+        // and other referenced files through it
+        Assimp::Importer importer;
+        MappedIOSystem* ioSystem = new MappedIOSystem();
+        importer.SetIOHandler(ioSystem);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
+        result.sourceFiles = ioSystem->OpenedPaths();
+        // check for errors
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        {
+            log << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            return false;
+        }
+
+        // process ASSIMP's root node recursively
+        result.imported.reserve(scene->mNumMeshes);
+        processNode(scene->mRootNode, scene, result.imported);
+
+        // weld, then reorder for the vertex cache, overdraw and vertex fetch once here; the cache keeps the result
+        VertexCacheStats before, after;
+        for (size_t i = 0; i < result.imported.size(); i++)
+        {
+            MeshData& data = result.imported[i];
+            WeldStats weld = WeldMesh(data);
+            log << "Welded " << path << " mesh " << i << ": " << weld.verticesBefore << " -> " << weld.verticesAfter << " vertices (-"
+                << weld.VertexReduction() * 100.0f << "%), " << weld.trianglesBefore << " -> " << weld.trianglesAfter << " triangles (-"
+                << weld.TriangleReduction() * 100.0f << "%)" << endl;
+
+            VertexCacheStats meshBefore, meshAfter;
+            OptimizeMesh(data, meshBefore, meshAfter);
+            before += meshBefore;
+            after += meshAfter;
+
+            BuildMeshLods(data);
+            log << "LODs of " << path << " mesh " << i << ":";
+            for (const MeshLod& lod : data.lods)
+                log << " " << lod.indexCount / 3;
+            log << " triangles" << endl;
+
+            BuildMeshlets(data);
+            data.geometryHash = HashGeometry(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), data.vertexFormat, data.lods);
+        }
+        log << "Optimized " << path << ": ACMR " << before.ACMR() << " -> " << after.ACMR()
+            << ", ATVR " << before.ATVR() << " -> " << after.ATVR() << endl;
+
+        vector<string> dependencies;
+        for (const string& file : result.sourceFiles)
+            if (file != path)
+                dependencies.push_back(file);
+        if (!MeshCache::Store(path, importFlags, result.imported, dependencies))
+            log << "WARNING::MESH_CACHE:: Could not write cache for " << path << endl;
+
+        for (const MeshData& data : result.imported)
+            result.meshes.push_back(data.View());
+    }
+
+    result.boundsMin = glm::vec3(0.0f);
+    result.boundsMax = glm::vec3(0.0f);
+    for (unsigned int i = 0; i < result.meshes.size(); i++)
+    {
+        result.boundsMin = i == 0 ? result.meshes[i].boundsMin : glm::min(result.boundsMin, result.meshes[i].boundsMin);
+        result.boundsMax = i == 0 ? result.meshes[i].boundsMax : glm::max(result.boundsMax, result.meshes[i].boundsMax);
+    }
+    return true;
+}
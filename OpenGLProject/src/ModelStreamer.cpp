@@ -0,0 +1,238 @@
+#include <lib/ModelStreamer.h>
+
+#include <atomic>
+#include <chrono>
+
+#include <lib/ThreadPool.h>
+
+namespace {
+
+    enum JobState {
+        JOB_IMPORTING,
+        JOB_IMPORTED,
+        JOB_FAILED
+    };
+
+    double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+}
+
+struct ModelStreamer::Job {
+    std::shared_ptr<Model> model;
+    string path;
+    unsigned int importFlags;
+    bool useCache;
+    std::atomic<int> state;
+
+    // filled in on the pool, only read on the GL thread once state is JOB_IMPORTED
+    ModelImport import;
+
+    // GL thread: the textures this model has to load itself because no other model had them yet, by position in
+    // textures_loaded, and their files, once the meshes' textures are resolved. images is sized once before any
+    // decode is submitted.
+    bool texturesResolved;
+    vector<size_t> textureIndices;
+    vector<TextureSource> textureSources;
+    // Model::contentsVersion the textures were taken at
+    unsigned int contentsVersion;
+    vector<DecodedImage> images;
+
+    // number of finished decodes, the images are packed into texture arrays once all of them are
+    std::atomic<size_t> decoded;
+    bool packing;
+    TexturePacker packer;
+
+    // GL thread progress
+    size_t meshesUploaded;
+
+    Job() : importFlags(0), useCache(true), state(JOB_IMPORTING), texturesResolved(false), contentsVersion(0), decoded(0), packing(false),
+        meshesUploaded(0) {}
+
+    ~Job() {
+        for (DecodedImage& image : images)
+            FreeImage(image);
+    }
+};
+
+ModelStreamer::~ModelStreamer() {
+    // models that outlive the streamer load what they request themselves, what it was still loading included
+    for (const std::shared_ptr<Job>& job : m_jobs)
+    {
+        Model& model = *job->model;
+        if (model.contentsVersion == job->contentsVersion)
+            model.pendingTextures.insert(model.pendingTextures.end(), job->textureIndices.begin(), job->textureIndices.end());
+    }
+    for (const std::weak_ptr<Model>& tracked : m_models)
+    {
+        std::shared_ptr<Model> model = tracked.lock();
+        if (model)
+            model->streamed = false;
+    }
+}
+
+std::shared_ptr<Model> ModelStreamer::Load(const string& path, bool gamma, MeshResidency residency, ImportProfile profile, bool useCache, const Shader* shader) {
+    std::shared_ptr<Model> model(new Model());
+    model->gammaCorrection = gamma;
+    model->residency = residency;
+    model->importProfile = profile;
+    model->setTargetShader(shader);
+    start(model, path, useCache);
+    Track(model);
+    return model;
+}
+
+std::shared_ptr<Model> ModelStreamer::Reload(const Model& model, const string& path) {
+    std::shared_ptr<Model> reload(new Model());
+    reload->gammaCorrection = model.gammaCorrection;
+    reload->residency = model.residency;
+    reload->importProfile = model.importProfile;
+    reload->vertexStreams = model.vertexStreams;
+    reload->loadAllTextures = model.loadAllTextures;
+    reload->loadSamplers = model.loadSamplers;
+    reload->textureNamePrefix = model.textureNamePrefix;
+    start(reload, path, false);
+    return reload;
+}
+
+void ModelStreamer::Track(const std::shared_ptr<Model>& model) {
+    model->streamed = true;
+    m_models.push_back(model);
+}
+
+void ModelStreamer::start(const std::shared_ptr<Model>& model, const string& path, bool useCache) {
+    model->directory = path.substr(0, path.find_last_of('/'));
+
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->model = model;
+    job->path = path;
+    // taken here, the model's settings are only read on the GL thread
+    job->importFlags = ImportFlagsFor(model->importProfile);
+    job->useCache = useCache;
+    m_jobs.push_back(job);
+
+    // the pool job holds on to the job, so it stays alive even if the streamer goes away first
+    ThreadPool::Shared().Submit([job] {
+        job->state = ImportModel(job->path, job->importFlags, job->import, job->useCache) ? JOB_IMPORTED : JOB_FAILED;
+    });
+}
+
+void ModelStreamer::startTextures(const std::shared_ptr<Model>& model) {
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->model = model;
+    job->state = JOB_IMPORTED;
+    job->texturesResolved = true;
+    decodeTextures(job);
+    m_jobs.push_back(job);
+}
+
+void ModelStreamer::decodeTextures(const std::shared_ptr<Job>& job) {
+    Model& model = *job->model;
+    job->textureIndices.swap(model.pendingTextures);
+    job->contentsVersion = model.contentsVersion;
+    for (size_t index : job->textureIndices)
+        job->textureSources.push_back(model.sourceOf(model.textures_loaded[index]));
+    job->images.resize(job->textureSources.size());
+
+    for (size_t i = 0; i < job->textureSources.size(); i++)
+    {
+        ThreadPool::Shared().Submit([job, i] {
+            DecodeAndHashImage(job->textureSources[i].path, job->images[i]);
+            job->decoded++;
+        });
+    }
+}
+
+void ModelStreamer::Update(double budgetSeconds) {
+    double deadline = now() + budgetSeconds;
+
+    // textures the models' draws requested since the last frame
+    for (size_t i = 0; i < m_models.size();)
+    {
+        std::shared_ptr<Model> model = m_models[i].lock();
+        if (!model)
+        {
+            m_models.erase(m_models.begin() + i);
+            continue;
+        }
+        // a model that is still loading gets its textures with its meshes
+        if (model->ready && !model->pendingTextures.empty())
+            startTextures(model);
+        i++;
+    }
+    for (size_t i = 0; i < m_jobs.size();)
+    {
+        if (advance(m_jobs[i], deadline))
+            m_jobs.erase(m_jobs.begin() + i);
+        else
+            i++;
+        if (now() >= deadline)
+            break;
+    }
+}
+
+bool ModelStreamer::IsIdle() const {
+    return m_jobs.empty();
+}
+
+bool ModelStreamer::advance(const std::shared_ptr<Job>& self, double deadline) {
+    Job& job = *self;
+    if (job.state == JOB_IMPORTING)
+        return false;
+    if (job.state == JOB_FAILED)
+        return true;
+
+    Model& model = *job.model;
+    if (!job.texturesResolved)
+    {
+        model.boundsMin = job.import.boundsMin;
+        model.boundsMax = job.import.boundsMax;
+        model.boundsKnown = true;
+        model.sourceFiles = job.import.sourceFiles;
+        model.meshes.reserve(job.import.meshes.size());
+
+        // resolving the textures up front lets their decodes overlap with the geometry uploads
+        for (MeshView& mesh : job.import.meshes)
+            model.resolveTextures(mesh);
+        job.texturesResolved = true;
+        decodeTextures(self);
+    }
+
+    // 1. geometry, one mesh per step
+    while (job.meshesUploaded < job.import.meshes.size())
+    {
+        model.uploadMesh(job.import, job.meshesUploaded++);
+        if (now() >= deadline)
+            return false;
+    }
+
+    // 2. textures once all are decoded, packing them into arrays needs every layout known. Then an array
+    // allocation or a layer per step.
+    if (job.decoded < job.textureSources.size())
+        return false;
+    if (!job.packing)
+    {
+        job.packer.Begin(job.textureSources, std::move(job.images));
+        job.images.clear();
+        job.packing = true;
+    }
+    while (job.packer.Step())
+        if (now() >= deadline)
+            return false;
+    vector<TextureSlot> slots = job.packer.Finish();
+    if (model.contentsVersion == job.contentsVersion)
+    {
+        model.applyTextureSlots(job.textureIndices, slots);
+    }
+    else
+    {
+        // a hot reload swapped in other contents meanwhile, which request their own textures
+        for (size_t i = 0; i < slots.size(); i++)
+            if (slots[i].id != 0)
+                TextureRegistry::Instance().Release(job.textureSources[i]);
+    }
+
+    model.ready = true;
+    return true;
+}
@@ -67,6 +67,11 @@ Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
 
     //Finally we save the ID of the created shader program
     m_id = shaderProgram;
+
+    //Remember which samplers and attributes the program reads, models only load the textures and vertex streams it uses
+
+    collectActiveSamplers();
+    collectActiveAttributes();
 }
 
 void Shader::useProgram() {
@@ -76,12 +81,80 @@ void Shader::useProgram() {
 void Shader::deleteProgram() {
     glDeleteProgram(m_id);
     m_id = 0;
+    m_activeSamplers.clear();
+    m_activeAttributeLocations.clear();
 }
 
 unsigned int Shader::GetID() {
     return m_id;
 }
 
+const std::unordered_set<std::string>& Shader::GetActiveSamplers() const {
+    return m_activeSamplers;
+}
+
+bool Shader::IsSamplerActive(const std::string& name) const {
+    return m_activeSamplers.count(name) != 0;
+}
+
+const std::vector<GLint>& Shader::GetActiveAttributeLocations() const {
+    return m_activeAttributeLocations;
+}
+
+void Shader::collectActiveAttributes() {
+    m_activeAttributeLocations.clear();
+    GLint attributeCount = 0;
+    glGetProgramiv(m_id, GL_ACTIVE_ATTRIBUTES, &attributeCount);
+    for (GLint i = 0; i < attributeCount; i++)
+    {
+        GLchar name[256];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib(m_id, (GLuint)i, sizeof(name), &length, &size, &type, name);
+        //Built-ins like gl_VertexID are listed too but have no location
+        GLint location = glGetAttribLocation(m_id, name);
+        if (location >= 0)
+            m_activeAttributeLocations.push_back(location);
+    }
+}
+
+void Shader::collectActiveSamplers() {
+    m_activeSamplers.clear();
+    GLint uniformCount = 0;
+    glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &uniformCount);
+    for (GLint i = 0; i < uniformCount; i++)
+    {
+        GLchar name[256];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_id, (GLuint)i, sizeof(name), &length, &size, &type, name);
+        switch (type)
+        {
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_SAMPLER_BUFFER:
+            break;
+        default:
+            continue;
+        }
+        //Sampler arrays are listed as their first element
+        std::string uniform(name, length);
+        if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+            uniform.resize(uniform.size() - 3);
+        m_activeSamplers.insert(uniform);
+    }
+}
+
 void Shader::setBool(const std::string& name, bool value) const  {
     glUniform1i(glGetUniformLocation(m_id, name.c_str()), (int)value);
 }
@@ -0,0 +1,180 @@
+#include <lib/TextureCache.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+    const char CacheMagic[4] = { 'T', 'E', 'X', 'C' };
+
+    struct CacheHeader {
+        char     magic[4];
+        uint32_t version;
+        uint32_t filter;
+        uint32_t components;
+        uint32_t channelCount;
+        uint8_t  channelSources[4];
+        uint8_t  channelSwizzle[4];
+        uint32_t padding;
+        int64_t  sourceModifiedTime;
+        uint64_t sourceSize;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        uint32_t sourcePathLength;
+    };
+
+    size_t alignUp(size_t offset) {
+        return (offset + 3) & ~(size_t)3;
+    }
+
+    bool validChannels(const CacheHeader& header) {
+        if (header.channelCount < 1 || header.channelCount > 4)
+            return false;
+        for (int c = 0; c < 4; c++)
+            if (header.channelSources[c] > 3 || header.channelSwizzle[c] > CHANNEL_ONE
+                || (header.channelSwizzle[c] < CHANNEL_ZERO && header.channelSwizzle[c] >= header.channelCount))
+                return false;
+        return true;
+    }
+
+}
+
+std::string TextureCache::CachePathFor(const std::string& sourcePath) {
+    return sourcePath + ".texcache";
+}
+
+bool TextureCache::Open(const std::string& sourcePath, MipFilter filter) {
+    Close();
+
+    FileStamp stamp;
+    if (!GetFileStamp(sourcePath, stamp) || !m_file.Open(CachePathFor(sourcePath)))
+        return false;
+
+    const unsigned char* data = m_file.Data();
+    size_t size = m_file.Size();
+    CacheHeader header;
+    if (size < sizeof(header))
+    {
+        Close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    size_t offset = alignUp(sizeof(header) + header.sourcePathLength);
+    if (std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0
+        || header.version != Version
+        || header.filter != (uint32_t)filter
+        || header.sourceModifiedTime != stamp.modifiedTime
+        || header.sourceSize != stamp.size
+        || header.components < 1 || header.components > 4
+        || !validChannels(header)
+        || header.width == 0 || header.height == 0
+        || offset > size
+        || sourcePath.compare(0, std::string::npos, (const char*)data + sizeof(header), header.sourcePathLength) != 0)
+    {
+        Close();
+        return false;
+    }
+
+    // the level sizes follow from the base size, exactly as BuildMipChain halves them
+    int width = (int)header.width;
+    int height = (int)header.height;
+    for (uint32_t i = 0; i < header.levelCount; i++)
+    {
+        size_t levelSize = (size_t)width * height * header.channelCount;
+        if (levelSize > size - offset)
+        {
+            Close();
+            return false;
+        }
+        m_levels.push_back({ width, height, data + offset });
+        offset += levelSize;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    m_components = (int)header.components;
+    m_channels.count = (int)header.channelCount;
+    for (int c = 0; c < 4; c++)
+    {
+        m_channels.sources[c] = header.channelSources[c];
+        m_channels.swizzle[c] = header.channelSwizzle[c];
+    }
+    return !m_levels.empty();
+}
+
+void TextureCache::Close() {
+    m_levels.clear();
+    m_components = 0;
+    m_channels = ChannelLayout();
+    m_file.Close();
+}
+
+int TextureCache::Components() const {
+    return m_components;
+}
+
+const ChannelLayout& TextureCache::Channels() const {
+    return m_channels;
+}
+
+const std::vector<MipLevelView>& TextureCache::Levels() const {
+    return m_levels;
+}
+
+bool TextureCache::Store(const std::string& sourcePath, MipFilter filter, int components, const ChannelLayout& channels, const std::vector<MipLevel>& chain) {
+    FileStamp stamp;
+    if (chain.empty() || !GetFileStamp(sourcePath, stamp))
+        return false;
+
+    CacheHeader header;
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = Version;
+    header.filter = (uint32_t)filter;
+    header.components = (uint32_t)components;
+    header.channelCount = (uint32_t)channels.count;
+    for (int c = 0; c < 4; c++)
+    {
+        header.channelSources[c] = channels.sources[c];
+        header.channelSwizzle[c] = channels.swizzle[c];
+    }
+    header.padding = 0;
+    header.sourceModifiedTime = stamp.modifiedTime;
+    header.sourceSize = stamp.size;
+    header.width = (uint32_t)chain[0].width;
+    header.height = (uint32_t)chain[0].height;
+    header.levelCount = (uint32_t)chain.size();
+    header.sourcePathLength = (uint32_t)sourcePath.size();
+
+    // write to a temporary file first so a crash never leaves a truncated cache behind
+    std::string cachePath = CachePathFor(sourcePath);
+    std::string tempPath = TempPathFor(cachePath);
+    {
+        const char padding[4] = {};
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out.write((const char*)&header, sizeof(header));
+        out.write(sourcePath.data(), sourcePath.size());
+        out.write(padding, alignUp(sizeof(header) + sourcePath.size()) - (sizeof(header) + sourcePath.size()));
+        for (const MipLevel& level : chain)
+            out.write((const char*)level.pixels.data(), level.pixels.size());
+        if (!out)
+        {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    // another writer may have put the same cache in place meanwhile, this one's copy is dropped then
+    std::remove(cachePath.c_str());
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,658 @@
+#include <lib/TextureLoader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+
+#include <stb_image.h>
+
+#include <lib/FileUtils.h>
+#include <lib/TextureRegistry.h>
+#include <lib/ThreadPool.h>
+
+namespace {
+
+    // written once on the GL thread before any decode that depends on them is started
+    std::atomic<bool> supportsS3TC(false);
+    std::atomic<bool> supportsS3TCsRGB(false);
+    std::atomic<bool> supportsBPTC(false);
+    std::atomic<bool> supportsRGTC(false);
+
+    // glTexStorage2D (GL 4.2 / ARB_texture_storage) isn't part of the GL 3.3 glad, so it's loaded by hand.
+    // Null when the context doesn't have it; only used on the GL thread.
+    typedef void (APIENTRYP TexStorage2DProc)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+    TexStorage2DProc texStorage2D = nullptr;
+    typedef void (APIENTRYP TexStorage3DProc)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+    TexStorage3DProc texStorage3D = nullptr;
+
+    // GL 3.3 guarantees at least this many layers per array
+    const size_t MAX_ARRAY_LAYERS = 256;
+
+    // box matches what glGenerateMipmap used to give us and keeps cold loads cheap,
+    // the asset cooker uses the sharper Kaiser filter
+    const MipFilter RUNTIME_MIP_FILTER = MIP_FILTER_BOX;
+
+    GLenum internalFormatFor(int channels) {
+        switch (channels)
+        {
+        case 1:
+            return GL_R8;
+        case 2:
+            return GL_RG8;
+        case 3:
+            return GL_RGB8;
+        default:
+            return GL_RGBA8;
+        }
+    }
+
+    GLenum pixelFormatFor(int channels) {
+        switch (channels)
+        {
+        case 1:
+            return GL_RED;
+        case 2:
+            return GL_RG;
+        case 3:
+            return GL_RGB;
+        default:
+            return GL_RGBA;
+        }
+    }
+
+    GLenum swizzleFor(unsigned char source) {
+        switch (source)
+        {
+        case 0:
+            return GL_RED;
+        case 1:
+            return GL_GREEN;
+        case 2:
+            return GL_BLUE;
+        case 3:
+            return GL_ALPHA;
+        case CHANNEL_ZERO:
+            return GL_ZERO;
+        default:
+            return GL_ONE;
+        }
+    }
+
+    // what the block compressed formats store; single channel maps (cooked specular intensity) read back as grey
+    // like the image they came from
+    ChannelLayout compressedChannels(GLenum format) {
+        ChannelLayout channels;
+        if (format == GL_COMPRESSED_RED_RGTC1)
+        {
+            channels.count = 1;
+            channels.swizzle[1] = 0;
+            channels.swizzle[2] = 0;
+            channels.swizzle[3] = CHANNEL_ONE;
+        }
+        else if (format == GL_COMPRESSED_RG_RGTC2)
+        {
+            channels.count = 2;
+            channels.swizzle[2] = CHANNEL_ZERO;
+            channels.swizzle[3] = CHANNEL_ONE;
+        }
+        return channels;
+    }
+
+    void setSwizzle(GLenum target, const TextureLayout& layout) {
+        const GLenum parameters[4] = { GL_TEXTURE_SWIZZLE_R, GL_TEXTURE_SWIZZLE_G, GL_TEXTURE_SWIZZLE_B, GL_TEXTURE_SWIZZLE_A };
+        for (int c = 0; c < 4; c++)
+            glTexParameteri(target, parameters[c], (GLint)layout.swizzle[c]);
+    }
+
+    // whether the cooked file exists and is at least as new as the image it was cooked from; a cooked file
+    // without its source is all there is
+    bool isCookedCurrent(const std::string& cookedPath, const std::string& sourcePath) {
+        FileStamp cooked, source;
+        if (!GetFileStamp(cookedPath, cooked))
+            return false;
+        return !GetFileStamp(sourcePath, source) || cooked.modifiedTime >= source.modifiedTime;
+    }
+
+    bool readCompressed(const std::string& path, DecodedImage& image) {
+        if (!ReadCompressedTexture(path, image.compressed))
+            return false;
+        if (!IsTextureFormatSupported(image.compressed.format))
+        {
+            image.compressed = CompressedImage();
+            return false;
+        }
+        image.width = image.compressed.width;
+        image.height = image.compressed.height;
+        image.components = image.compressed.format == GL_COMPRESSED_RED_RGTC1 ? 1 : image.compressed.format == GL_COMPRESSED_RG_RGTC2 ? 2 : 4;
+        image.channels = compressedChannels(image.compressed.format);
+        return true;
+    }
+
+    void uploadCompressed(unsigned int textureID, const CompressedImage& image, const TextureLayout& layout) {
+        size_t bytes = 0;
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        if (texStorage2D)
+            texStorage2D(GL_TEXTURE_2D, (GLsizei)image.levels.size(), image.format, image.width, image.height);
+        for (size_t level = 0; level < image.levels.size(); level++)
+        {
+            const CompressedMipLevel& mip = image.levels[level];
+            if (texStorage2D)
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, mip.width, mip.height, image.format, (GLsizei)mip.size, image.data.data() + mip.offset);
+            else
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.format, mip.width, mip.height, 0, (GLsizei)mip.size, image.data.data() + mip.offset);
+            bytes += mip.size;
+        }
+        TextureRegistry::Instance().RecordUpload(textureID, bytes);
+
+        // the stored chain may be partial, never sample past it
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        setSwizzle(GL_TEXTURE_2D, layout);
+    }
+
+    // the same sampling as uploadCompressed/UploadTexture give 2D textures, for the bound array
+    void setArrayParameters(const TextureLayout& layout) {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, layout.levels - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, layout.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        setSwizzle(GL_TEXTURE_2D_ARRAY, layout);
+    }
+
+    // Files decoded by the shared pool and the calling thread together: whoever comes first claims the next file, so
+    // the caller only ever waits for decodes that are running. Calling from a pool job, or while the pool is busy
+    // with other work, can't deadlock. The jobs hold the batch, one that only starts once the caller is done finds
+    // nothing left to claim.
+    struct DecodeBatch {
+        std::vector<std::string> paths;
+        // DecodeAndHashImage instead of DecodeImage
+        bool hash;
+        std::vector<DecodedImage> images;
+        std::atomic<size_t> next;
+        std::mutex mutex;
+        std::condition_variable finished;
+        // decoded images nobody took yet
+        std::deque<size_t> decoded;
+
+        static std::shared_ptr<DecodeBatch> Start(const std::vector<std::string>& paths, bool hash) {
+            std::shared_ptr<DecodeBatch> batch = std::make_shared<DecodeBatch>();
+            batch->paths = paths;
+            batch->hash = hash;
+            batch->images.resize(paths.size());
+            batch->next = 0;
+            size_t jobs = std::min(paths.size(), (size_t)ThreadPool::Shared().ThreadCount());
+            for (size_t job = 0; job < jobs; job++)
+                ThreadPool::Shared().Submit([batch] {
+                    while (batch->DecodeNext())
+                        ;
+                });
+            return batch;
+        }
+
+        // decodes the next unclaimed file, false if there was none left
+        bool DecodeNext() {
+            size_t i = next++;
+            if (i >= paths.size())
+                return false;
+            if (hash)
+                DecodeAndHashImage(paths[i], images[i]);
+            else
+                DecodeImage(paths[i], images[i]);
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(i);
+            finished.notify_one();
+            return true;
+        }
+
+        // index of the next decoded image, decoding unclaimed files on the calling thread rather than waiting
+        size_t Take() {
+            while (true)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!decoded.empty())
+                        break;
+                }
+                if (!DecodeNext())
+                    break;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return !decoded.empty(); });
+            size_t i = decoded.front();
+            decoded.pop_front();
+            return i;
+        }
+    };
+
+    // storage for layers images of first's layout into the array textureID, left bound, with its sampling set
+    void allocateArray(unsigned int textureID, const DecodedImage& first, size_t layers) {
+        TextureLayout layout = LayoutOf(first);
+        GLsizei depth = (GLsizei)layers;
+        bool compressed = first.compressed.format != 0;
+
+        size_t bytes = 0;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+        if (texStorage3D)
+            texStorage3D(GL_TEXTURE_2D_ARRAY, layout.levels, layout.internalFormat, layout.width, layout.height, depth);
+        for (int level = 0; level < layout.levels; level++)
+        {
+            if (compressed)
+            {
+                const CompressedMipLevel& mip = first.compressed.levels[level];
+                if (!texStorage3D)
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, layout.internalFormat, mip.width, mip.height, depth, 0, (GLsizei)(mip.size * layers), nullptr);
+                bytes += mip.size * layers;
+            }
+            else
+            {
+                const MipLevelView& mip = first.levels[level];
+                if (!texStorage3D)
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, layout.internalFormat, mip.width, mip.height, depth, 0, pixelFormatFor(first.channels.count), GL_UNSIGNED_BYTE, nullptr);
+                bytes += (size_t)mip.width * mip.height * first.channels.count * layers;
+            }
+        }
+        TextureRegistry::Instance().RecordUpload(textureID, bytes);
+        setArrayParameters(layout);
+    }
+
+    // every level of the image into one layer of the bound array
+    void uploadLayer(unsigned int layer, const DecodedImage& image) {
+        if (image.compressed.format != 0)
+        {
+            const CompressedImage& compressed = image.compressed;
+            for (size_t level = 0; level < compressed.levels.size(); level++)
+            {
+                const CompressedMipLevel& mip = compressed.levels[level];
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, (GLint)layer, mip.width, mip.height, 1, compressed.format,
+                    (GLsizei)mip.size, compressed.data.data() + mip.offset);
+            }
+            return;
+        }
+        // packed channels have rows of any length
+        GLenum format = pixelFormatFor(image.channels.count);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t level = 0; level < image.levels.size(); level++)
+        {
+            const MipLevelView& mip = image.levels[level];
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, (GLint)layer, mip.width, mip.height, 1, format, GL_UNSIGNED_BYTE, mip.pixels);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+}
+
+void DetectTextureSupport(GLADloadproc loadProc) {
+    GLint major = 0, minor = 0, extensionCount = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+
+    bool s3tc = false;
+    bool s3tcSRGB = false;
+    bool bptc = major > 4 || (major == 4 && minor >= 2);
+    bool storage = bptc;
+    for (GLint i = 0; i < extensionCount; i++)
+    {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (!name)
+            continue;
+        std::string extension(name);
+        if (extension == "GL_EXT_texture_compression_s3tc")
+            s3tc = true;
+        else if (extension == "GL_EXT_texture_sRGB" || extension == "GL_EXT_texture_compression_s3tc_srgb")
+            s3tcSRGB = true;
+        else if (extension == "GL_ARB_texture_compression_bptc")
+            bptc = true;
+        else if (extension == "GL_ARB_texture_storage")
+            storage = true;
+    }
+
+    supportsS3TC = s3tc;
+    supportsS3TCsRGB = s3tc && s3tcSRGB;
+    supportsBPTC = bptc;
+    supportsRGTC = true; // core since GL 3.0
+    texStorage2D = storage ? (TexStorage2DProc)loadProc("glTexStorage2D") : nullptr;
+    texStorage3D = storage ? (TexStorage3DProc)loadProc("glTexStorage3D") : nullptr;
+}
+
+bool IsTextureFormatSupported(GLenum format) {
+    switch (format)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return supportsS3TC;
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        return supportsS3TCsRGB;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+        return supportsBPTC;
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_RG_RGTC2:
+        return supportsRGTC;
+    default:
+        return false;
+    }
+}
+
+bool DecodeImage(const std::string& path, DecodedImage& image, bool preferCooked) {
+    if (IsCompressedTexturePath(path))
+        return readCompressed(path, image);
+
+    // prefer a cooked, block compressed version of the image if there is one next to it and the image wasn't
+    // edited since it was cooked
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (preferCooked && dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    {
+        std::string stem = path.substr(0, dot);
+        if ((isCookedCurrent(stem + ".ktx", path) && readCompressed(stem + ".ktx", image))
+            || (isCookedCurrent(stem + ".dds", path) && readCompressed(stem + ".dds", image)))
+            return true;
+    }
+
+    if (MapCachedImage(path, image))
+        return true;
+
+    // always expanded to RGBA so the filters work on one layout, the stored channels are picked afterwards
+    unsigned char* pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 4);
+    if (!pixels)
+        return false;
+    image.mips = BuildMipChain(pixels, image.width, image.height, RUNTIME_MIP_FILTER);
+    stbi_image_free(pixels);
+
+    image.channels = AnalyzeChannels(image.mips[0].pixels.data(), (size_t)image.width * image.height);
+    if (image.channels.count < 4)
+    {
+        for (MipLevel& level : image.mips)
+        {
+            size_t pixelCount = (size_t)level.width * level.height;
+            std::vector<unsigned char> packed(pixelCount * image.channels.count);
+            PackChannels(level.pixels.data(), pixelCount, image.channels, packed.data());
+            level.pixels.swap(packed);
+        }
+    }
+    for (const MipLevel& level : image.mips)
+        image.levels.push_back(level.View());
+    if (!TextureCache::Store(path, RUNTIME_MIP_FILTER, image.components, image.channels, image.mips))
+        std::cout << "WARNING::TEXTURE_CACHE:: Failed to write cache for " << path << std::endl;
+    return true;
+}
+
+bool MapCachedImage(const std::string& path, DecodedImage& image) {
+    // the cache stores the chain already reduced to the channels the texture keeps
+    std::shared_ptr<TextureCache> cache = std::make_shared<TextureCache>();
+    if (!cache->Open(path, RUNTIME_MIP_FILTER))
+        return false;
+    image.width = cache->Levels()[0].width;
+    image.height = cache->Levels()[0].height;
+    image.components = cache->Components();
+    image.levels = cache->Levels();
+    image.cache = cache;
+    image.channels = cache->Channels();
+    return true;
+}
+
+bool DecodeAndHashImage(const std::string& path, DecodedImage& image, bool preferCooked) {
+    if (!DecodeImage(path, image, preferCooked))
+        return false;
+    image.hashed = TextureRegistry::HashImage(path, image.content);
+    return true;
+}
+
+void FreeImage(DecodedImage& image) {
+    image.levels.clear();
+    image.mips.clear();
+    image.mips.shrink_to_fit();
+    image.cache.reset();
+    image.compressed = CompressedImage();
+    image.channels = ChannelLayout();
+    image.hashed = false;
+}
+
+void UploadTexture(unsigned int textureID, const DecodedImage& image) {
+    TextureLayout layout = LayoutOf(image);
+    if (image.compressed.format != 0)
+    {
+        uploadCompressed(textureID, image.compressed, layout);
+        return;
+    }
+
+    // the levels hold only the channels the analysis kept
+    size_t bytes = 0;
+    GLenum format = pixelFormatFor(image.channels.count);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (texStorage2D)
+        texStorage2D(GL_TEXTURE_2D, layout.levels, layout.internalFormat, image.width, image.height);
+    for (size_t level = 0; level < image.levels.size(); level++)
+    {
+        const MipLevelView& mip = image.levels[level];
+        if (texStorage2D)
+            glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, mip.width, mip.height, format, GL_UNSIGNED_BYTE, mip.pixels);
+        else
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, layout.internalFormat, mip.width, mip.height, 0, format, GL_UNSIGNED_BYTE, mip.pixels);
+        bytes += (size_t)mip.width * mip.height * image.channels.count;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    TextureRegistry::Instance().RecordUpload(textureID, bytes);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levels.size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    setSwizzle(GL_TEXTURE_2D, layout);
+}
+
+TextureLayout LayoutOf(const DecodedImage& image) {
+    TextureLayout layout;
+    layout.width = image.width;
+    layout.height = image.height;
+    if (image.compressed.format != 0)
+    {
+        layout.internalFormat = image.compressed.format;
+        layout.levels = (int)image.compressed.levels.size();
+    }
+    else
+    {
+        layout.internalFormat = internalFormatFor(image.channels.count);
+        layout.levels = (int)image.levels.size();
+    }
+    for (int c = 0; c < 4; c++)
+        layout.swizzle[c] = swizzleFor(image.channels.swizzle[c]);
+    return layout;
+}
+
+void UploadTextureArray(unsigned int textureID, const std::vector<const DecodedImage*>& images) {
+    allocateArray(textureID, *images[0], images.size());
+    for (size_t layer = 0; layer < images.size(); layer++)
+        uploadLayer((unsigned int)layer, *images[layer]);
+}
+
+void UploadTextureLayer(unsigned int textureID, unsigned int layer, const DecodedImage& image) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    uploadLayer(layer, image);
+}
+
+std::vector<TextureSlot> PackTextures(const std::vector<TextureSource>& sources, std::vector<DecodedImage>& images) {
+    TexturePacker packer;
+    packer.Begin(sources, std::move(images));
+    images.clear();
+    while (packer.Step())
+        ;
+    return packer.Finish();
+}
+
+TexturePacker::TexturePacker() : m_group(0), m_layer(0) {
+}
+
+TexturePacker::~TexturePacker() {
+    TextureRegistry& registry = TextureRegistry::Instance();
+    for (size_t i = 0; i < m_slots.size(); i++)
+        if (m_slots[i].id != 0)
+            registry.Release(m_sources[i]);
+}
+
+void TexturePacker::Begin(const std::vector<TextureSource>& sources, std::vector<DecodedImage> images) {
+    TextureRegistry& registry = TextureRegistry::Instance();
+    m_sources = sources;
+    m_images = std::move(images);
+    m_slots.assign(sources.size(), TextureSlot());
+    m_groups.clear();
+    m_group = 0;
+    m_layer = 0;
+    for (size_t i = 0; i < m_sources.size(); i++)
+    {
+        // another model may have loaded the file while this one was decoding, or one with the same contents ever
+        DecodedImage& image = m_images[i];
+        if (registry.Acquire(m_sources[i], m_slots[i], image.hashed ? &image.content : nullptr))
+        {
+            FreeImage(image);
+            continue;
+        }
+        if (!image.IsDecoded())
+        {
+            std::cout << "Texture failed to load at path: " << m_sources[i].path << std::endl;
+            continue;
+        }
+
+        TextureLayout layout = LayoutOf(image);
+        size_t group = 0;
+        while (group < m_groups.size() && (m_groups[group].layout != layout || m_groups[group].members.size() == MAX_ARRAY_LAYERS))
+            group++;
+        if (group == m_groups.size())
+        {
+            m_groups.push_back(Group());
+            m_groups.back().layout = layout;
+            m_groups.back().textureID = 0;
+        }
+        m_groups[group].members.push_back(i);
+    }
+}
+
+bool TexturePacker::Step() {
+    if (m_group == m_groups.size())
+        return false;
+
+    Group& group = m_groups[m_group];
+    if (group.textureID == 0)
+    {
+        // another packer may have added some of the files since Begin, registering them twice would orphan its layers
+        TextureRegistry& registry = TextureRegistry::Instance();
+        std::vector<size_t> missing;
+        for (size_t i : group.members)
+        {
+            DecodedImage& image = m_images[i];
+            if (registry.Acquire(m_sources[i], m_slots[i], image.hashed ? &image.content : nullptr))
+                FreeImage(image);
+            else
+                missing.push_back(i);
+        }
+        group.members.swap(missing);
+        if (group.members.empty())
+        {
+            m_group++;
+            return m_group < m_groups.size();
+        }
+
+        glGenTextures(1, &group.textureID);
+        std::vector<TextureSource> groupSources;
+        std::vector<const ContentHash*> groupContents;
+        for (size_t layer = 0; layer < group.members.size(); layer++)
+        {
+            size_t i = group.members[layer];
+            groupSources.push_back(m_sources[i]);
+            groupContents.push_back(m_images[i].hashed ? &m_images[i].content : nullptr);
+            m_slots[i].id = group.textureID;
+            m_slots[i].layer = (unsigned int)layer;
+        }
+        // registered before the allocation, which records its size
+        registry.AddArray(group.textureID, groupSources, groupContents, group.layout);
+        allocateArray(group.textureID, m_images[group.members[0]], group.members.size());
+        return true;
+    }
+
+    DecodedImage& image = m_images[group.members[m_layer]];
+    UploadTextureLayer(group.textureID, (unsigned int)m_layer, image);
+    FreeImage(image);
+    if (++m_layer == group.members.size())
+    {
+        m_group++;
+        m_layer = 0;
+    }
+    return m_group < m_groups.size();
+}
+
+std::vector<TextureSlot> TexturePacker::Finish() {
+    for (DecodedImage& image : m_images)
+        FreeImage(image);
+    m_images.clear();
+    m_groups.clear();
+    m_group = 0;
+    m_layer = 0;
+    // the references go to the caller with the slots
+    std::vector<TextureSlot> slots;
+    slots.swap(m_slots);
+    return slots;
+}
+
+std::vector<TextureSlot> LoadTextureArrays(const std::vector<TextureSource>& sources) {
+    std::vector<std::string> paths;
+    for (const TextureSource& source : sources)
+        paths.push_back(source.path);
+    std::shared_ptr<DecodeBatch> batch = DecodeBatch::Start(paths, true);
+    for (size_t i = 0; i < sources.size(); i++)
+        batch->Take();
+    // every image is taken, late jobs only find nothing left to claim
+    return PackTextures(sources, batch->images);
+}
+
+void LoadTextures(const std::vector<TextureLoadRequest>& requests) {
+    if (requests.empty())
+        return;
+
+    std::vector<std::string> paths;
+    for (const TextureLoadRequest& request : requests)
+        paths.push_back(request.path);
+    std::shared_ptr<DecodeBatch> batch = DecodeBatch::Start(paths, false);
+    for (size_t uploaded = 0; uploaded < requests.size(); uploaded++)
+    {
+        size_t i = batch->Take();
+        DecodedImage& image = batch->images[i];
+        if (image.IsDecoded())
+            UploadTexture(requests[i].textureID, image);
+        else
+            std::cout << "Texture failed to load at path: " << requests[i].path << std::endl;
+        FreeImage(image);
+    }
+}
+
+unsigned int TextureFromFile(const char* path, const std::string& directory, bool gamma)
+{
+    std::string filename = std::string(path);
+    filename = directory + '/' + filename;
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    DecodedImage image;
+    if (DecodeImage(filename, image))
+        UploadTexture(textureID, image);
+    else
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    FreeImage(image);
+
+    return textureID;
+}
@@ -0,0 +1,290 @@
+#include <lib/TextureRegistry.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#include <glad/glad.h>
+
+TextureRegistry::TextureRegistry() : m_generation(0) {
+    m_stats.hits = 0;
+    m_stats.contentHits = 0;
+    m_stats.misses = 0;
+    m_stats.textures = 0;
+    m_stats.arrays = 0;
+    m_stats.residentBytes = 0;
+    m_stats.reusedBytes = 0;
+}
+
+TextureRegistry& TextureRegistry::Instance() {
+    static TextureRegistry registry;
+    return registry;
+}
+
+std::string TextureRegistry::Usage(const std::string& type, bool gamma) {
+    return gamma ? type + " srgb" : type;
+}
+
+bool TextureRegistry::Acquire(const TextureSource& source, TextureSlot& slot, const ContentHash* content) {
+    std::string key = keyFor(source);
+    std::unordered_map<std::string, TextureSlot>::iterator found = m_slotsByPath.find(key);
+    bool byContent = false;
+    if (found == m_slotsByPath.end())
+    {
+        // a new name may still hold bytes that are already loaded for the same usage
+        std::unordered_map<ContentHash, TextureSlot>::iterator same = content ? m_slotsByContent.find(contentKeyFor(*content, source.usage)) : m_slotsByContent.end();
+        if (same == m_slotsByContent.end())
+            return false;
+        found = m_slotsByPath.insert(std::make_pair(key, same->second)).first;
+        byContent = true;
+    }
+
+    slot = found->second;
+    Entry& entry = m_entries[slot.id];
+    Layer& layer = entry.layers[slot.layer];
+    layer.references[key]++;
+    layer.refCount++;
+    entry.refCount++;
+    m_stats.hits++;
+    if (byContent)
+        m_stats.contentHits++;
+    m_stats.reusedBytes += entry.bytes / entry.layers.size();
+    return true;
+}
+
+void TextureRegistry::AddArray(unsigned int textureID, const std::vector<TextureSource>& sources, const std::vector<const ContentHash*>& contents,
+    const TextureLayout& layout) {
+    Entry entry;
+    entry.refCount = (unsigned int)sources.size();
+    entry.layout = layout;
+    entry.bytes = 0;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        Layer layer;
+        layer.references[keyFor(sources[i])] = 1;
+        layer.usage = sources[i].usage;
+        layer.refCount = 1;
+        layer.hashed = contents[i] != nullptr;
+        if (layer.hashed)
+            layer.content = contentKeyFor(*contents[i], layer.usage);
+        entry.layers.push_back(layer);
+    }
+
+    for (size_t i = 0; i < entry.layers.size(); i++)
+    {
+        TextureSlot slot;
+        slot.id = textureID;
+        slot.layer = (unsigned int)i;
+        mapLayer(entry.layers[i], slot);
+    }
+    m_entries[textureID] = entry;
+    m_stats.misses += sources.size();
+    m_stats.textures += sources.size();
+    m_stats.arrays++;
+}
+
+void TextureRegistry::Release(const TextureSource& source) {
+    dropReferences(keyFor(source), 1);
+}
+
+void TextureRegistry::RecordUpload(unsigned int textureID, size_t bytes) {
+    std::unordered_map<unsigned int, Entry>::iterator found = m_entries.find(textureID);
+    if (found == m_entries.end())
+        return;
+    m_stats.residentBytes += bytes - found->second.bytes;
+    found->second.bytes = bytes;
+}
+
+TextureSlot TextureRegistry::Find(const TextureSource& source) const {
+    std::unordered_map<std::string, TextureSlot>::const_iterator found = m_slotsByPath.find(keyFor(source));
+    return found == m_slotsByPath.end() ? TextureSlot() : found->second;
+}
+
+std::vector<std::string> TextureRegistry::Usages(const std::string& path) const {
+    std::string prefix = CanonicalPath(path) + '\n';
+    std::vector<std::string> usages;
+    for (const std::pair<const std::string, TextureSlot>& mapped : m_slotsByPath)
+        if (mapped.first.compare(0, prefix.size(), prefix) == 0)
+            usages.push_back(mapped.first.substr(prefix.size()));
+    return usages;
+}
+
+const TextureLayout* TextureRegistry::Layout(unsigned int textureID) const {
+    std::unordered_map<unsigned int, Entry>::const_iterator found = m_entries.find(textureID);
+    return found == m_entries.end() ? nullptr : &found->second.layout;
+}
+
+bool TextureRegistry::IsShared(const TextureSource& source) const {
+    std::unordered_map<std::string, TextureSlot>::const_iterator found = m_slotsByPath.find(keyFor(source));
+    if (found == m_slotsByPath.end())
+        return false;
+    return m_entries.at(found->second.id).layers[found->second.layer].references.size() > 1;
+}
+
+void TextureRegistry::Rehash(const TextureSource& source, const ContentHash* content) {
+    TextureSlot slot;
+    Layer* layer = layerOf(keyFor(source), slot);
+    if (!layer)
+        return;
+
+    // the new contents may match another texture's from now on
+    unmapLayer(*layer, slot);
+    layer->hashed = content != nullptr;
+    if (layer->hashed)
+        layer->content = contentKeyFor(*content, layer->usage);
+    mapLayer(*layer, slot);
+}
+
+void TextureRegistry::MoveTexture(const TextureSource& source, unsigned int newID, const TextureLayout& layout, const ContentHash* content) {
+    std::string key = keyFor(source);
+    TextureSlot slot;
+    Layer* old = layerOf(key, slot);
+    if (!old)
+        return;
+
+    // the old layer keeps serving the other files with its contents, if there are any
+    Layer moved;
+    moved.references[key] = old->references[key];
+    moved.refCount = moved.references[key];
+    moved.usage = old->usage;
+    moved.hashed = content != nullptr;
+    if (moved.hashed)
+        moved.content = contentKeyFor(*content, moved.usage);
+    dropReferences(key, moved.refCount);
+
+    Entry entry;
+    entry.layers.push_back(moved);
+    entry.refCount = moved.refCount;
+    entry.layout = layout;
+    entry.bytes = 0;
+    m_entries[newID] = entry;
+    TextureSlot newSlot;
+    newSlot.id = newID;
+    mapLayer(m_entries[newID].layers[0], newSlot);
+    m_stats.textures++;
+    m_stats.arrays++;
+    m_generation++;
+}
+
+unsigned int TextureRegistry::Generation() const {
+    return m_generation;
+}
+
+TextureRegistry::Stats TextureRegistry::GetStats() const {
+    return m_stats;
+}
+
+size_t TextureRegistry::TextureBytes(unsigned int textureID) const {
+    std::unordered_map<unsigned int, Entry>::const_iterator found = m_entries.find(textureID);
+    return found == m_entries.end() ? 0 : found->second.bytes;
+}
+
+std::string TextureRegistry::CanonicalPath(const std::string& path) {
+    // resolve against the file system first so "a/../b.png" and "b.png" end up the same
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    std::string result = _fullpath(resolved, path.c_str(), _MAX_PATH) ? std::string(resolved) : path;
+    for (char& c : result)
+    {
+        if (c == '\\')
+            c = '/';
+        else if (c >= 'A' && c <= 'Z') // the file system is case insensitive
+            c = c - 'A' + 'a';
+    }
+    return result;
+#else
+    char resolved[PATH_MAX];
+    return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+#endif
+}
+
+std::string TextureRegistry::keyFor(const TextureSource& source) {
+    return CanonicalPath(source.path) + '\n' + source.usage;
+}
+
+ContentHash TextureRegistry::contentKeyFor(const ContentHash& content, const std::string& usage) {
+    return HashString(usage, content);
+}
+
+bool TextureRegistry::HashImage(const std::string& path, ContentHash& hash) {
+    if (!HashFile(path, hash))
+        return false;
+
+    // two equal images can still have been cooked differently, the cooked files decide what gets uploaded
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return true;
+    std::string stem = path.substr(0, dot);
+    HashFile(stem + ".ktx", hash, hash);
+    HashFile(stem + ".dds", hash, hash);
+    return true;
+}
+
+void TextureRegistry::mapLayer(const Layer& layer, const TextureSlot& slot) {
+    for (const std::pair<const std::string, unsigned int>& references : layer.references)
+        m_slotsByPath[references.first] = slot;
+    // the first texture with some contents keeps serving them
+    if (layer.hashed && !m_slotsByContent.count(layer.content))
+        m_slotsByContent[layer.content] = slot;
+}
+
+void TextureRegistry::unmapLayer(const Layer& layer, const TextureSlot& slot) {
+    for (const std::pair<const std::string, unsigned int>& references : layer.references)
+    {
+        std::unordered_map<std::string, TextureSlot>::iterator found = m_slotsByPath.find(references.first);
+        if (found != m_slotsByPath.end() && found->second.id == slot.id && found->second.layer == slot.layer)
+            m_slotsByPath.erase(found);
+    }
+    std::unordered_map<ContentHash, TextureSlot>::iterator found = layer.hashed ? m_slotsByContent.find(layer.content) : m_slotsByContent.end();
+    if (found != m_slotsByContent.end() && found->second.id == slot.id && found->second.layer == slot.layer)
+        m_slotsByContent.erase(found);
+}
+
+TextureRegistry::Layer* TextureRegistry::layerOf(const std::string& key, TextureSlot& slot) {
+    std::unordered_map<std::string, TextureSlot>::iterator found = m_slotsByPath.find(key);
+    if (found == m_slotsByPath.end())
+        return nullptr;
+    slot = found->second;
+    std::unordered_map<unsigned int, Entry>::iterator entry = m_entries.find(slot.id);
+    if (entry == m_entries.end() || slot.layer >= entry->second.layers.size())
+        return nullptr;
+    return &entry->second.layers[slot.layer];
+}
+
+void TextureRegistry::dropReferences(const std::string& key, unsigned int count) {
+    TextureSlot slot;
+    Layer* layer = layerOf(key, slot);
+    if (!layer)
+        return;
+    std::unordered_map<std::string, unsigned int>::iterator references = layer->references.find(key);
+    if (references == layer->references.end())
+        return;
+
+    count = std::min(count, references->second);
+    references->second -= count;
+    layer->refCount -= count;
+    std::unordered_map<unsigned int, Entry>::iterator entry = m_entries.find(slot.id);
+    entry->second.refCount -= count;
+    if (references->second == 0)
+    {
+        m_slotsByPath.erase(key);
+        layer->references.erase(references);
+    }
+    if (layer->refCount == 0)
+    {
+        // the layer stays allocated until the whole array goes, but nothing finds it anymore
+        unmapLayer(*layer, slot);
+        m_stats.textures--;
+    }
+    if (entry->second.refCount == 0)
+        releaseEntry(entry);
+}
+
+void TextureRegistry::releaseEntry(std::unordered_map<unsigned int, Entry>::iterator entry) {
+    unsigned int textureID = entry->first;
+    glDeleteTextures(1, &textureID);
+    m_stats.arrays--;
+    m_stats.residentBytes -= entry->second.bytes;
+    m_entries.erase(entry);
+}
@@ -0,0 +1,75 @@
+#include <lib/ThreadPool.h>
+
+ThreadPool::ThreadPool(unsigned int threadCount) : m_stopping(false) {
+    if (threadCount == 0)
+        threadCount = 1;
+    for (unsigned int i = 0; i < threadCount; i++)
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_wakeup.notify_one();
+}
+
+unsigned int ThreadPool::ThreadCount() const {
+    return (unsigned int)m_workers.size();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0)
+        return;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t remaining = count;
+
+    // body and the counters live on this stack frame, which outlives every job because we wait for them below
+    for (size_t i = 0; i < count; i++)
+    {
+        Submit([&, i] {
+            body(i);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0)
+                finished.notify_one();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return remaining == 0; });
+}
+
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1);
+    return pool;
+}
+
+void ThreadPool::workerLoop() {
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            // finish queued work before shutting down so nobody waits on a job that never runs
+            if (m_jobs.empty())
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,626 @@
+#include <lib/VirtualTextureCache.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+
+#include <stb_image.h>
+
+#include <lib/TextureLoader.h>
+#include <lib/TextureRegistry.h>
+#include <lib/ThreadPool.h>
+
+namespace {
+
+    // feedback writes the texture index plus one into an 8 bit channel, 0 meaning no virtual texture
+    const size_t MAX_VIRTUAL_TEXTURES = 255;
+    // page table entries address tiles with 8 bits per axis
+    const int MAX_ATLAS_TILES = 256;
+    // and pages with 8 bits per axis in the feedback
+    const int MAX_PAGES = 256;
+
+    // a page: texture index, level and position within the level
+    uint64_t pageKey(unsigned int index, int level, int x, int y) {
+        return (uint64_t)index << 48 | (uint64_t)level << 40 | (uint64_t)y << 20 | (uint64_t)x;
+    }
+
+    unsigned int keyIndex(uint64_t key) {
+        return (unsigned int)(key >> 48);
+    }
+
+    int keyLevel(uint64_t key) {
+        return (int)((key >> 40) & 0xff);
+    }
+
+    int keyY(uint64_t key) {
+        return (int)((key >> 20) & 0xfffff);
+    }
+
+    int keyX(uint64_t key) {
+        return (int)(key & 0xfffff);
+    }
+
+    int pagesFor(int texels) {
+        return (texels + VIRTUAL_PAGE_SIZE - 1) / VIRTUAL_PAGE_SIZE;
+    }
+
+    int nextPowerOfTwo(int value) {
+        int power = 1;
+        while (power < value)
+            power *= 2;
+        return power;
+    }
+
+    // borders wrap around like GL_REPEAT, which the models' texture coordinates rely on
+    int wrap(int value, int size) {
+        value %= size;
+        return value < 0 ? value + size : value;
+    }
+
+}
+
+// an image being decoded on the pool, written there until decoded is set
+struct VirtualTextureCache::Decode {
+    DecodedImage image;
+    std::atomic<bool> decoded;
+
+    Decode() : decoded(false) {}
+};
+
+struct VirtualTextureCache::VirtualTexture {
+    std::string path;
+    unsigned int refCount;
+    unsigned int index;
+    unsigned int pageTable;
+
+    // the pages are cut from source; a decode of the file in flight replaces it once done
+    DecodedImage source;
+    std::shared_ptr<Decode> decode;
+
+    // decoded, with its page table allocated and its coarsest level resident
+    bool resident;
+    bool failed;
+    int topLevel;
+    // page table size on level 0, powers of two so the page counts of all levels fit into one mip chain
+    int tableWidth;
+    int tableHeight;
+    size_t tableBytes;
+    // pages on each side of every level up to topLevel, and the tile holding each page (-1 if it isn't resident)
+    std::vector<glm::ivec2> pages;
+    std::vector<std::vector<int>> tiles;
+    bool tableDirty;
+
+    VirtualTexture() : refCount(0), index(0), pageTable(0), resident(false), failed(false), topLevel(0),
+        tableWidth(0), tableHeight(0), tableBytes(0), tableDirty(false) {}
+};
+
+VirtualTextureCache::VirtualTextureCache()
+    : m_atlasTiles(0), m_atlas(0), m_updates(0), m_feedbackFramebuffer(0), m_feedbackColor(0), m_feedbackDepth(0),
+    m_feedbackWidth(0), m_feedbackHeight(0), m_readbackNext(0), m_savedFramebuffer(0)
+{
+    m_readbackBuffers[0] = m_readbackBuffers[1] = 0;
+    m_readbackWidth[0] = m_readbackWidth[1] = 0;
+    m_readbackHeight[0] = m_readbackHeight[1] = 0;
+    m_stats.textures = 0;
+    m_stats.tiles = 0;
+    m_stats.residentPages = 0;
+    m_stats.requestedPages = 0;
+    m_stats.pagesLoaded = 0;
+    m_stats.pagesEvicted = 0;
+    m_stats.residentBytes = 0;
+}
+
+VirtualTextureCache& VirtualTextureCache::Instance() {
+    static VirtualTextureCache cache;
+    return cache;
+}
+
+bool VirtualTextureCache::Enable(size_t budgetBytes) {
+    if (m_atlas != 0)
+        return false;
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    size_t tileBytes = (size_t)VIRTUAL_TILE_SIZE * VIRTUAL_TILE_SIZE * 4;
+    int tiles = (int)std::sqrt((double)(budgetBytes / tileBytes));
+    tiles = std::min(std::min(tiles, MAX_ATLAS_TILES), (int)maxSize / VIRTUAL_TILE_SIZE);
+    if (tiles < 2)
+    {
+        std::cout << "WARNING::VIRTUAL_TEXTURE:: A budget of " << budgetBytes << " bytes is too small for the atlas" << std::endl;
+        return false;
+    }
+
+    m_atlasTiles = tiles;
+    glGenTextures(1, &m_atlas);
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, tiles * VIRTUAL_TILE_SIZE, tiles * VIRTUAL_TILE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // handed out from the back, so tile 0 goes first
+    for (int tile = tiles * tiles - 1; tile >= 0; tile--)
+        m_freeTiles.push_back(tile);
+    m_staging.resize(tileBytes);
+    glGenBuffers(2, m_readbackBuffers);
+
+    m_stats.tiles = (size_t)tiles * tiles;
+    m_stats.residentBytes += m_stats.tiles * tileBytes;
+    return true;
+}
+
+bool VirtualTextureCache::IsEnabled() const {
+    return m_atlas != 0;
+}
+
+bool VirtualTextureCache::ShouldPage(const std::string& path) const {
+    // pages are cut from the RGBA mip chain, block compressed files are uploaded as they are
+    if (m_atlas == 0 || IsCompressedTexturePath(path))
+        return false;
+    int width, height, components;
+    if (!stbi_info(path.c_str(), &width, &height, &components))
+        return false;
+    int size = std::max(width, height);
+    return size > VIRTUAL_TEXTURE_MIN_SIZE && size <= MAX_PAGES * VIRTUAL_PAGE_SIZE;
+}
+
+unsigned int VirtualTextureCache::Acquire(const std::string& path) {
+    std::string key = TextureRegistry::CanonicalPath(path);
+    std::unordered_map<std::string, std::shared_ptr<VirtualTexture>>::iterator found = m_byPath.find(key);
+    if (found != m_byPath.end())
+    {
+        found->second->refCount++;
+        return found->second->pageTable;
+    }
+
+    size_t index = 0;
+    while (index < m_byIndex.size() && m_byIndex[index])
+        index++;
+    if (index == MAX_VIRTUAL_TEXTURES)
+    {
+        std::cout << "WARNING::VIRTUAL_TEXTURE:: Too many virtual textures, can't page " << path << std::endl;
+        return 0;
+    }
+    if (index == m_byIndex.size())
+        m_byIndex.push_back(nullptr);
+
+    std::shared_ptr<VirtualTexture> texture = std::make_shared<VirtualTexture>();
+    texture->path = key;
+    texture->refCount = 1;
+    texture->index = (unsigned int)index;
+    glGenTextures(1, &texture->pageTable);
+    m_byPath[key] = texture;
+    m_byPageTable[texture->pageTable] = texture;
+    m_byIndex[index] = texture;
+    m_stats.textures++;
+    startDecode(*texture);
+    return texture->pageTable;
+}
+
+void VirtualTextureCache::Release(unsigned int pageTableID) {
+    std::unordered_map<unsigned int, std::shared_ptr<VirtualTexture>>::iterator found = m_byPageTable.find(pageTableID);
+    if (found == m_byPageTable.end() || --found->second->refCount > 0)
+        return;
+
+    VirtualTexture& texture = *found->second;
+    dropPages(texture);
+    glDeleteTextures(1, &texture.pageTable);
+    m_stats.residentBytes -= texture.tableBytes;
+    m_stats.textures--;
+    m_byIndex[texture.index].reset();
+    m_byPath.erase(texture.path);
+    m_byPageTable.erase(found);
+}
+
+bool VirtualTextureCache::Reload(const std::string& path) {
+    std::unordered_map<std::string, std::shared_ptr<VirtualTexture>>::iterator found = m_byPath.find(TextureRegistry::CanonicalPath(path));
+    if (found == m_byPath.end())
+        return false;
+    startDecode(*found->second);
+    return true;
+}
+
+bool VirtualTextureCache::GetParameters(unsigned int pageTableID, Parameters& parameters) const {
+    std::unordered_map<unsigned int, std::shared_ptr<VirtualTexture>>::const_iterator found = m_byPageTable.find(pageTableID);
+    if (found == m_byPageTable.end())
+        return false;
+
+    // a texture that isn't resident yet has an empty page table, which samples as grey
+    const VirtualTexture& texture = *found->second;
+    if (texture.resident)
+        parameters.size = glm::vec4(texture.source.levels[0].width, texture.source.levels[0].height, texture.topLevel, 0.0f);
+    else
+        parameters.size = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+    parameters.index = (float)texture.index;
+    return true;
+}
+
+unsigned int VirtualTextureCache::AtlasTexture() const {
+    return m_atlas;
+}
+
+int VirtualTextureCache::AtlasTiles() const {
+    return m_atlasTiles;
+}
+
+void VirtualTextureCache::BeginFeedback(int viewportWidth, int viewportHeight) {
+    if (m_atlas == 0)
+        return;
+
+    int width = std::max(viewportWidth / VIRTUAL_FEEDBACK_SCALE, 1);
+    int height = std::max(viewportHeight / VIRTUAL_FEEDBACK_SCALE, 1);
+    if (width != m_feedbackWidth || height != m_feedbackHeight)
+    {
+        if (m_feedbackFramebuffer == 0)
+        {
+            glGenFramebuffers(1, &m_feedbackFramebuffer);
+            glGenRenderbuffers(1, &m_feedbackColor);
+            glGenRenderbuffers(1, &m_feedbackDepth);
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_feedbackColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_feedbackDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: Feedback framebuffer is not complete!" << std::endl;
+        m_feedbackWidth = width;
+        m_feedbackHeight = height;
+    }
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, m_savedClearColor);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+    glViewport(0, 0, m_feedbackWidth, m_feedbackHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTextureCache::EndFeedback() {
+    if (m_atlas == 0)
+        return;
+
+    // into a pixel pack buffer, so the read finishes in the background and Update maps it a frame later
+    int slot = m_readbackNext;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_readbackBuffers[slot]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)m_feedbackWidth * m_feedbackHeight * 4, nullptr, GL_STREAM_READ);
+    glReadPixels(0, 0, m_feedbackWidth, m_feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_readbackWidth[slot] = m_feedbackWidth;
+    m_readbackHeight[slot] = m_feedbackHeight;
+    m_readbackNext = slot ^ 1;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+    glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+    glClearColor(m_savedClearColor[0], m_savedClearColor[1], m_savedClearColor[2], m_savedClearColor[3]);
+}
+
+float VirtualTextureCache::FeedbackLodBias() {
+    return -std::log2((float)VIRTUAL_FEEDBACK_SCALE);
+}
+
+void VirtualTextureCache::Update(size_t maxPages) {
+    if (m_atlas == 0)
+        return;
+    m_updates++;
+
+    for (std::unordered_map<unsigned int, std::shared_ptr<VirtualTexture>>::value_type& entry : m_byPageTable)
+    {
+        VirtualTexture& texture = *entry.second;
+        if (!texture.decode || !texture.decode->decoded)
+            continue;
+        std::shared_ptr<Decode> decode = std::move(texture.decode);
+        // a reload that failed keeps the pages of the previous image
+        if (texture.resident && !decode->image.IsDecoded())
+        {
+            std::cout << "Texture failed to load at path: " << texture.path << std::endl;
+            continue;
+        }
+
+        // the new image may have other levels and page counts, its page table is built anew
+        bool reloaded = texture.resident;
+        if (reloaded)
+        {
+            dropPages(texture);
+            texture.pages.clear();
+            texture.tiles.clear();
+            m_stats.residentBytes -= texture.tableBytes;
+            texture.tableBytes = 0;
+            texture.resident = false;
+        }
+        texture.source = std::move(decode->image);
+        texture.failed = false;
+        makeResident(texture);
+        if (reloaded && texture.resident)
+            std::cout << "Reloaded texture " << texture.path << std::endl;
+    }
+
+    // coarse pages first, they stand in for the finer ones until those are loaded
+    std::vector<uint64_t> missing;
+    readFeedback(missing);
+    std::stable_sort(missing.begin(), missing.end(), [](uint64_t a, uint64_t b) { return keyLevel(a) > keyLevel(b); });
+    for (size_t i = 0; i < missing.size() && i < maxPages; i++)
+    {
+        if (!loadPage(missing[i], false))
+            break;
+    }
+
+    for (std::unordered_map<unsigned int, std::shared_ptr<VirtualTexture>>::value_type& entry : m_byPageTable)
+    {
+        if (entry.second->tableDirty)
+            updatePageTable(*entry.second);
+    }
+}
+
+VirtualTextureCache::Stats VirtualTextureCache::GetStats() const {
+    return m_stats;
+}
+
+void VirtualTextureCache::startDecode(VirtualTexture& texture) {
+    // the pool job holds on to the decode, a release or reload before it finishes only drops the result
+    std::shared_ptr<Decode> decode = std::make_shared<Decode>();
+    texture.decode = decode;
+    std::string path = texture.path;
+    ThreadPool::Shared().Submit([decode, path] {
+        // the cooked versions are block compressed, the pages are cut from the RGBA chain
+        DecodeImage(path, decode->image, false);
+        // a fresh decode holds the whole chain in memory, the cache file it just wrote serves the pages from a
+        // mapping instead, so only the pages read stay in memory
+        DecodedImage mapped;
+        if (!decode->image.mips.empty() && MapCachedImage(path, mapped))
+            decode->image = std::move(mapped);
+        decode->decoded = true;
+    });
+}
+
+void VirtualTextureCache::makeResident(VirtualTexture& texture) {
+    if (!texture.source.IsDecoded() || texture.source.levels.empty())
+    {
+        std::cout << "Texture failed to load at path: " << texture.path << std::endl;
+        texture.failed = true;
+        return;
+    }
+
+    // the levels up to the first that fits into a single page
+    const std::vector<MipLevelView>& levels = texture.source.levels;
+    texture.topLevel = 0;
+    while (texture.topLevel + 1 < (int)levels.size() && (levels[texture.topLevel].width > VIRTUAL_PAGE_SIZE || levels[texture.topLevel].height > VIRTUAL_PAGE_SIZE))
+        texture.topLevel++;
+    for (int level = 0; level <= texture.topLevel; level++)
+    {
+        glm::ivec2 pages(pagesFor(levels[level].width), pagesFor(levels[level].height));
+        texture.pages.push_back(pages);
+        texture.tiles.push_back(std::vector<int>((size_t)pages.x * pages.y, -1));
+    }
+
+    texture.tableWidth = nextPowerOfTwo(texture.pages[0].x);
+    texture.tableHeight = nextPowerOfTwo(texture.pages[0].y);
+    glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+    for (int level = 0; level <= texture.topLevel; level++)
+    {
+        int width = std::max(texture.tableWidth >> level, 1);
+        int height = std::max(texture.tableHeight >> level, 1);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        texture.tableBytes += (size_t)width * height * 4;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.topLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    m_stats.residentBytes += texture.tableBytes;
+    texture.resident = true;
+    texture.tableDirty = true;
+
+    // the coarsest level never leaves the atlas, every other page falls back to it
+    for (int y = 0; y < texture.pages[texture.topLevel].y; y++)
+    {
+        for (int x = 0; x < texture.pages[texture.topLevel].x; x++)
+        {
+            if (!loadPage(pageKey(texture.index, texture.topLevel, x, y), true))
+                std::cout << "WARNING::VIRTUAL_TEXTURE:: The atlas is too small to keep " << texture.path << " resident" << std::endl;
+        }
+    }
+}
+
+void VirtualTextureCache::dropPages(VirtualTexture& texture) {
+    for (size_t level = 0; level < texture.tiles.size(); level++)
+    {
+        for (size_t page = 0; page < texture.tiles[level].size(); page++)
+        {
+            if (texture.tiles[level][page] >= 0)
+                evict(pageKey(texture.index, (int)level, (int)page % texture.pages[level].x, (int)page / texture.pages[level].x));
+        }
+    }
+}
+
+void VirtualTextureCache::readFeedback(std::vector<uint64_t>& missing) {
+    // the most recent feedback, its read had a whole frame to finish
+    int slot = m_readbackNext ^ 1;
+    if (m_readbackWidth[slot] == 0)
+        return;
+
+    size_t pixelCount = (size_t)m_readbackWidth[slot] * m_readbackHeight[slot];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_readbackBuffers[slot]);
+    const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)pixelCount * 4, GL_MAP_READ_BIT);
+    if (pixels)
+    {
+        std::unordered_set<uint64_t> requested;
+        for (size_t i = 0; i < pixelCount; i++)
+        {
+            // page x, page y, level, texture index plus one
+            const unsigned char* pixel = pixels + i * 4;
+            if (pixel[3] == 0)
+                continue;
+            unsigned int index = pixel[3] - 1u;
+            VirtualTexture* texture = index < m_byIndex.size() ? m_byIndex[index].get() : nullptr;
+            if (!texture || !texture->resident)
+                continue;
+
+            // the page and its coarser levels, which keeps the fallbacks for the finer pages resident as well
+            int x = pixel[0];
+            int y = pixel[1];
+            for (int level = std::min((int)pixel[2], texture->topLevel); level <= texture->topLevel; level++)
+            {
+                x = std::min(x, texture->pages[level].x - 1);
+                y = std::min(y, texture->pages[level].y - 1);
+                uint64_t key = pageKey(index, level, x, y);
+                // the coarser levels were requested along with it
+                if (!requested.insert(key).second)
+                    break;
+                request(key, missing);
+                x /= 2;
+                y /= 2;
+            }
+        }
+        m_stats.requestedPages = requested.size();
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_readbackWidth[slot] = 0;
+}
+
+void VirtualTextureCache::request(uint64_t key, std::vector<uint64_t>& missing) {
+    std::unordered_map<uint64_t, ResidentPage>::iterator found = m_resident.find(key);
+    if (found == m_resident.end())
+    {
+        missing.push_back(key);
+        return;
+    }
+    found->second.lastUsed = m_updates;
+    if (found->second.lru != m_lru.end())
+        m_lru.splice(m_lru.begin(), m_lru, found->second.lru);
+}
+
+bool VirtualTextureCache::loadPage(uint64_t key, bool pinned) {
+    VirtualTexture* texture = textureOf(key);
+    if (!texture || m_resident.count(key))
+        return true;
+    int tile = allocateTile();
+    if (tile < 0)
+        return false;
+
+    // the page and its border, wrapped around the edges of the level
+    int levelIndex = keyLevel(key);
+    int pageX = keyX(key);
+    int pageY = keyY(key);
+    // the atlas is RGBA8, levels that store fewer channels are expanded the way sampling them would
+    const MipLevelView& level = texture->source.levels[levelIndex];
+    const ChannelLayout& channels = texture->source.channels;
+    size_t pixelBytes = (size_t)channels.count;
+    int left = pageX * VIRTUAL_PAGE_SIZE - VIRTUAL_PAGE_BORDER;
+    int top = pageY * VIRTUAL_PAGE_SIZE - VIRTUAL_PAGE_BORDER;
+    bool inside = left >= 0 && left + VIRTUAL_TILE_SIZE <= level.width;
+    for (int row = 0; row < VIRTUAL_TILE_SIZE; row++)
+    {
+        const unsigned char* source = level.pixels + (size_t)wrap(top + row, level.height) * level.width * pixelBytes;
+        unsigned char* destination = m_staging.data() + (size_t)row * VIRTUAL_TILE_SIZE * 4;
+        if (inside)
+        {
+            ExpandChannels(source + (size_t)left * pixelBytes, VIRTUAL_TILE_SIZE, channels, destination);
+            continue;
+        }
+        for (int column = 0; column < VIRTUAL_TILE_SIZE; column++)
+            ExpandChannels(source + (size_t)wrap(left + column, level.width) * pixelBytes, 1, channels, destination + column * 4);
+    }
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (tile % m_atlasTiles) * VIRTUAL_TILE_SIZE, (tile / m_atlasTiles) * VIRTUAL_TILE_SIZE,
+        VIRTUAL_TILE_SIZE, VIRTUAL_TILE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, m_staging.data());
+
+    ResidentPage page;
+    page.tile = tile;
+    page.lastUsed = m_updates;
+    page.lru = pinned ? m_lru.end() : m_lru.insert(m_lru.begin(), key);
+    m_resident[key] = page;
+    texture->tiles[levelIndex][(size_t)pageY * texture->pages[levelIndex].x + pageX] = tile;
+    texture->tableDirty = true;
+    m_stats.residentPages++;
+    m_stats.pagesLoaded++;
+    return true;
+}
+
+int VirtualTextureCache::allocateTile() {
+    if (m_freeTiles.empty())
+    {
+        // everything left was requested by this feedback, evicting it would only load it again next frame
+        if (m_lru.empty() || m_resident[m_lru.back()].lastUsed == m_updates)
+            return -1;
+        evict(m_lru.back());
+        m_stats.pagesEvicted++;
+    }
+    int tile = m_freeTiles.back();
+    m_freeTiles.pop_back();
+    return tile;
+}
+
+void VirtualTextureCache::evict(uint64_t key) {
+    std::unordered_map<uint64_t, ResidentPage>::iterator found = m_resident.find(key);
+    if (found == m_resident.end())
+        return;
+
+    VirtualTexture* texture = textureOf(key);
+    int level = keyLevel(key);
+    texture->tiles[level][(size_t)keyY(key) * texture->pages[level].x + keyX(key)] = -1;
+    texture->tableDirty = true;
+    if (found->second.lru != m_lru.end())
+        m_lru.erase(found->second.lru);
+    m_freeTiles.push_back(found->second.tile);
+    m_resident.erase(found);
+    m_stats.residentPages--;
+}
+
+void VirtualTextureCache::updatePageTable(VirtualTexture& texture) {
+    // from the coarsest level down, so a page that isn't resident can take its parent's entry
+    std::vector<std::vector<unsigned char>> entries(texture.topLevel + 1);
+    glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+    for (int level = texture.topLevel; level >= 0; level--)
+    {
+        int width = std::max(texture.tableWidth >> level, 1);
+        int height = std::max(texture.tableHeight >> level, 1);
+        std::vector<unsigned char>& table = entries[level];
+        table.assign((size_t)width * height * 4, 0);
+
+        const glm::ivec2& pages = texture.pages[level];
+        for (int y = 0; y < pages.y; y++)
+        {
+            for (int x = 0; x < pages.x; x++)
+            {
+                // tile x, tile y, the level the tile holds, valid
+                unsigned char* entry = &table[((size_t)y * width + x) * 4];
+                int tile = texture.tiles[level][(size_t)y * pages.x + x];
+                if (tile >= 0)
+                {
+                    entry[0] = (unsigned char)(tile % m_atlasTiles);
+                    entry[1] = (unsigned char)(tile / m_atlasTiles);
+                    entry[2] = (unsigned char)level;
+                    entry[3] = 255;
+                }
+                else if (level < texture.topLevel)
+                {
+                    const glm::ivec2& parentPages = texture.pages[level + 1];
+                    int parentWidth = std::max(texture.tableWidth >> (level + 1), 1);
+                    int parentX = std::min(x / 2, parentPages.x - 1);
+                    int parentY = std::min(y / 2, parentPages.y - 1);
+                    memcpy(entry, &entries[level + 1][((size_t)parentY * parentWidth + parentX) * 4], 4);
+                }
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, table.data());
+    }
+    texture.tableDirty = false;
+}
+
+VirtualTextureCache::VirtualTexture* VirtualTextureCache::textureOf(uint64_t key) const {
+    unsigned int index = keyIndex(key);
+    return index < m_byIndex.size() ? m_byIndex[index].get() : nullptr;
+}
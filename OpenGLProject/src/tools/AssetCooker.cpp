@@ -0,0 +1,579 @@
+// Offline asset cooker. Imports every model through the same code path as Model and writes its mesh cache, then
+// finds the textures the models and .mtl files reference, builds their mip chains and block compresses them into
+// a DDS next to each source image, where DecodeImage picks it up instead of the PNG/JPEG. The runtime then only
+// maps the results.
+//
+// usage: AssetCooker [--bc1] [--box] [--threads N] [--profile NAME] [--force] [--manifest FILE] [path ...]
+//   path       model, .mtl file, image file or directory searched for models and .mtl files (default: resources)
+//   --bc1      encode color maps as BC1 instead of BC7: half the size and faster to cook, lower quality
+//   --box      build mip levels with a box filter instead of the sharper Kaiser filter
+//   --threads  number of worker threads, one per core by default
+//   --profile  import profile of the models, runtime by default (see ImportProfile.h)
+//   --force    cook everything, even assets the manifest says are up to date
+//   --manifest where the content hashes of the last cook are kept (default: resources/cook.manifest)
+//
+// Models are imported in parallel, one per thread. Textures are cooked one after the other, each compressed on all
+// threads. An asset is skipped when its output exists and the hashes of its settings and of every file it was
+// built from (a model's material libraries included) match the manifest.
+//
+// Color maps (map_Kd/map_Ka) become BC7 or BC1, specular maps (map_Ks) BC4 holding their intensity,
+// normal maps (map_Bump/bump/norm) BC5 holding x and y.
+
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <stb_image.h>
+
+#include <lib/BlockCompression.h>
+#include <lib/CompressedTexture.h>
+#include <lib/ContentHash.h>
+#include <lib/FileUtils.h>
+#include <lib/ImportProfile.h>
+#include <lib/MipChain.h>
+#include <lib/ModelImporter.h>
+#include <lib/ThreadPool.h>
+
+using namespace std;
+
+namespace {
+
+    enum TextureUsage {
+        USAGE_COLOR,
+        USAGE_SPECULAR,
+        USAGE_NORMAL
+    };
+
+    struct CookJob {
+        string path;
+        TextureUsage usage;
+    };
+
+    struct CookTotals {
+        size_t models = 0;
+        size_t textures = 0;
+        size_t skipped = 0;
+        size_t sourceBytes = 0;
+        size_t cookedBytes = 0;
+        double importSeconds = 0.0;
+        double encodeSeconds = 0.0;
+    };
+
+    // what an output was last cooked from: the hash of its settings and inputs, and the inputs themselves
+    struct ManifestEntry {
+        ContentHash key;
+        vector<string> inputs;
+    };
+    typedef unordered_map<string, ManifestEntry> Manifest;
+
+    // what cooking one model produced, merged into the manifest and texture list once all models are done
+    struct ModelResult {
+        bool cooked = false;
+        bool failed = false;
+        ManifestEntry entry;
+        vector<CookJob> textures;
+        double seconds = 0.0;
+    };
+
+    const char* MODEL_EXTENSIONS[] = { ".obj", ".fbx", ".gltf", ".glb", ".dae", ".3ds", ".ply" };
+
+    const double MEGABYTE = 1024.0 * 1024.0;
+
+    string toLower(string text) {
+        for (char& c : text)
+            c = (char)tolower((unsigned char)c);
+        return text;
+    }
+
+    bool hasExtension(const string& path, const string& extension) {
+        return path.size() > extension.size() && toLower(path.substr(path.size() - extension.size())) == extension;
+    }
+
+    string directoryOf(const string& path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == string::npos ? "." : path.substr(0, slash);
+    }
+
+    string ddsPathFor(const string& path) {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        if (dot == string::npos || (slash != string::npos && dot < slash))
+            return path + ".dds";
+        return path.substr(0, dot) + ".dds";
+    }
+
+    const char* formatName(GLenum format) {
+        switch (format)
+        {
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            return "BC1";
+        case GL_COMPRESSED_RED_RGTC1:
+            return "BC4";
+        case GL_COMPRESSED_RG_RGTC2:
+            return "BC5";
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+            return "BC7";
+        default:
+            return "?";
+        }
+    }
+
+    // a texture referenced by several materials is cooked once, for its first use
+    void addJob(vector<CookJob>& jobs, unordered_set<string>& seen, const string& path, TextureUsage usage) {
+        if (seen.insert(path).second)
+            jobs.push_back({ path, usage });
+    }
+
+    void collectMaterialTextures(const string& materialPath, vector<CookJob>& jobs, unordered_set<string>& seen) {
+        ifstream in(materialPath);
+        if (!in)
+        {
+            cout << "ERROR::COOKER:: Can't read material " << materialPath << endl;
+            return;
+        }
+
+        string line;
+        while (getline(in, line))
+        {
+            istringstream tokens(line);
+            string keyword;
+            if (!(tokens >> keyword))
+                continue;
+
+            keyword = toLower(keyword);
+            TextureUsage usage;
+            if (keyword == "map_kd" || keyword == "map_ka")
+                usage = USAGE_COLOR;
+            else if (keyword == "map_ks")
+                usage = USAGE_SPECULAR;
+            else if (keyword == "map_bump" || keyword == "bump" || keyword == "norm" || keyword == "map_kn")
+                usage = USAGE_NORMAL;
+            else
+                continue;
+
+            // options like "-bm 1" come first, the file name is the last token
+            string file, token;
+            while (tokens >> token)
+                file = token;
+            if (!file.empty())
+                addJob(jobs, seen, directoryOf(materialPath) + '/' + file, usage);
+        }
+    }
+
+    bool isModel(const string& path) {
+        for (const char* extension : MODEL_EXTENSIONS)
+            if (hasExtension(path, extension))
+                return true;
+        return false;
+    }
+
+    // the usage a mesh's texture type is cooked for, as the .mtl keywords Model maps to those types
+    TextureUsage usageOf(const string& textureType) {
+        if (textureType == "texture_specular")
+            return USAGE_SPECULAR;
+        if (textureType == "texture_normal")
+            return USAGE_NORMAL;
+        return USAGE_COLOR;
+    }
+
+    // one "output<TAB>key<TAB>input..." line per output; a missing manifest is an empty one
+    Manifest readManifest(const string& path) {
+        Manifest manifest;
+        ifstream in(path);
+        string line;
+        while (getline(in, line))
+        {
+            vector<string> fields;
+            size_t start = 0;
+            while (true)
+            {
+                size_t tab = line.find('\t', start);
+                fields.push_back(line.substr(start, tab == string::npos ? string::npos : tab - start));
+                if (tab == string::npos)
+                    break;
+                start = tab + 1;
+            }
+            ManifestEntry entry;
+            if (fields.size() < 3 || !ContentHash::FromHex(fields[1], entry.key))
+                continue;
+            entry.inputs.assign(fields.begin() + 2, fields.end());
+            manifest[fields[0]] = entry;
+        }
+        return manifest;
+    }
+
+    bool writeManifest(const string& path, const Manifest& manifest) {
+        ofstream out(path, ios::trunc);
+        for (const auto& output : manifest)
+        {
+            out << output.first << '\t' << output.second.key.ToHex();
+            for (const string& input : output.second.inputs)
+                out << '\t' << input;
+            out << '\n';
+        }
+        return (bool)out;
+    }
+
+    // hash of the settings an output is cooked with and the contents of every input, false if an input is unreadable
+    bool cookKey(const string& settings, const vector<string>& inputs, ContentHash& key) {
+        key = HashString(settings);
+        for (const string& input : inputs)
+            if (!HashFile(input, key, key))
+                return false;
+        return true;
+    }
+
+    // true if output exists and was cooked with the same settings from inputs that haven't changed since
+    bool isUpToDate(const Manifest& manifest, const string& output, const string& settings) {
+        auto entry = manifest.find(output);
+        FileStamp stamp;
+        if (entry == manifest.end() || !GetFileStamp(output, stamp))
+            return false;
+        ContentHash key;
+        return cookKey(settings, entry->second.inputs, key) && key == entry->second.key;
+    }
+
+    string modelSettings(unsigned int importFlags) {
+        ostringstream settings;
+        settings << "model cache " << MeshCache::Version << " flags " << importFlags << " vertex " << sizeof(Vertex);
+        return settings.str();
+    }
+
+    string textureSettings(const CookJob& job, GLenum format, MipFilter mipFilter) {
+        ostringstream settings;
+        settings << "texture " << formatName(format) << " filter " << (int)mipFilter << " usage " << (int)job.usage;
+        return settings.str();
+    }
+
+    GLenum textureFormat(const CookJob& job, GLenum colorFormat) {
+        if (job.usage == USAGE_NORMAL)
+            return GL_COMPRESSED_RG_RGTC2;
+        if (job.usage == USAGE_SPECULAR)
+            return GL_COMPRESSED_RED_RGTC1;
+        return colorFormat;
+    }
+
+    // imports the model the way Model does, which writes its mesh cache, unless the manifest says the cache is
+    // current; either way the textures its meshes reference are listed for cooking
+    ModelResult cookModel(const string& path, unsigned int importFlags, const Manifest& manifest, bool force, ostream& log) {
+        ModelResult result;
+        string output = MeshCache::CachePathFor(path);
+        string settings = modelSettings(importFlags);
+        vector<MeshView> meshes;
+
+        MeshCache cache;
+        if (!force && isUpToDate(manifest, output, settings) && cache.Open(path, importFlags))
+        {
+            meshes = cache.Entries();
+            result.entry = manifest.at(output);
+        }
+        else
+        {
+            ModelImport import;
+            auto start = chrono::steady_clock::now();
+            if (!ImportModel(path, importFlags, import, false, log))
+            {
+                result.failed = true;
+                return result;
+            }
+            result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            result.cooked = true;
+            meshes = import.meshes;
+            result.entry.inputs = import.sourceFiles;
+            if (!cookKey(settings, result.entry.inputs, result.entry.key))
+            {
+                log << "ERROR::COOKER:: Can't hash the sources of " << path << endl;
+                result.failed = true;
+                return result;
+            }
+
+            size_t vertices = 0, indices = 0;
+            for (const MeshView& mesh : meshes)
+            {
+                vertices += mesh.vertexCount;
+                indices += mesh.indexCount;
+            }
+            log << path << " -> " << output << ", " << meshes.size() << " meshes, " << vertices << " vertices, "
+                << indices / 3 << " triangles with all levels, " << fixed << setprecision(0) << result.seconds * 1000.0 << " ms" << endl;
+        }
+
+        unordered_set<string> seen;
+        for (const MeshView& mesh : meshes)
+            for (const Texture& texture : mesh.textures)
+                addJob(result.textures, seen, directoryOf(path) + '/' + texture.path, usageOf(texture.type));
+        return result;
+    }
+
+    // peak signal to noise ratio of the decoded top level against the source, over the channels the format keeps
+    double measurePSNR(GLenum format, const MipLevel& source, const unsigned char* data) {
+        vector<unsigned char> decoded(source.pixels.size());
+        DecompressImage(format, data, source.width, source.height, decoded.data());
+
+        int channels = CompressedChannelCount(format);
+        double squaredError = 0.0;
+        for (size_t pixel = 0; pixel < decoded.size(); pixel += 4)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                double delta = (double)decoded[pixel + c] - source.pixels[pixel + c];
+                squaredError += delta * delta;
+            }
+        }
+        double meanSquaredError = squaredError / ((double)source.width * source.height * channels);
+        return meanSquaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+    }
+
+    bool cookTexture(const CookJob& job, GLenum colorFormat, MipFilter mipFilter, ThreadPool& pool, CookTotals& totals) {
+        int width, height, components;
+        unsigned char* pixels = stbi_load(job.path.c_str(), &width, &height, &components, 4);
+        if (!pixels)
+        {
+            cout << "ERROR::COOKER:: Failed to load " << job.path << endl;
+            return false;
+        }
+
+        GLenum format = textureFormat(job, colorFormat);
+        if (job.usage == USAGE_SPECULAR)
+        {
+            // BC4 only keeps red, store the intensity there
+            for (size_t i = 0; i < (size_t)width * height * 4; i += 4)
+                pixels[i] = (unsigned char)((pixels[i] + pixels[i + 1] + pixels[i + 2] + 1) / 3);
+        }
+
+        vector<MipLevel> chain = BuildMipChain(pixels, width, height, mipFilter);
+        stbi_image_free(pixels);
+
+        CompressedImage image;
+        image.format = format;
+        image.width = width;
+        image.height = height;
+        size_t sourceBytes = 0;
+        for (const MipLevel& level : chain)
+        {
+            size_t size = CompressedLevelBytes(format, level.width, level.height);
+            image.levels.push_back({ level.width, level.height, image.data.size(), size });
+            image.data.resize(image.data.size() + size);
+            sourceBytes += level.pixels.size();
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < chain.size(); i++)
+            CompressImage(format, chain[i].pixels.data(), chain[i].width, chain[i].height, image.data.data() + image.levels[i].offset, pool);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        double psnr = measurePSNR(format, chain[0], image.data.data());
+
+        string outputPath = ddsPathFor(job.path);
+        if (!WriteDDS(outputPath, image))
+        {
+            cout << "ERROR::COOKER:: Failed to write " << outputPath << endl;
+            return false;
+        }
+
+        cout << job.path << " -> " << formatName(format) << " " << width << "x" << height << ", " << image.levels.size() << " levels, "
+            << fixed << setprecision(2) << sourceBytes / MEGABYTE << " MB -> " << image.data.size() / MEGABYTE << " MB, "
+            << setprecision(0) << seconds * 1000.0 << " ms (" << setprecision(1) << sourceBytes / MEGABYTE / seconds << " MB/s), "
+            << "PSNR " << setprecision(2) << psnr << " dB" << endl;
+
+        totals.textures++;
+        totals.sourceBytes += sourceBytes;
+        totals.cookedBytes += image.data.size();
+        totals.encodeSeconds += seconds;
+        return true;
+    }
+
+    void printUsage() {
+        cout << "usage: AssetCooker [--bc1] [--box] [--threads N] [--profile NAME] [--force] [--manifest FILE] [path ...]" << endl
+            << "  path       model, .mtl file, image file or directory searched for models and .mtl files (default: resources)" << endl
+            << "  --bc1      encode color maps as BC1 instead of BC7" << endl
+            << "  --box      build mip levels with a box filter instead of a Kaiser filter" << endl
+            << "  --threads  number of worker threads, one per core by default" << endl
+            << "  --profile  import profile of the models: fast-preview, runtime or full-quality (default: runtime)" << endl
+            << "  --force    cook everything, even assets that are up to date" << endl
+            << "  --manifest where the hashes of the last cook are kept (default: resources/cook.manifest)" << endl;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    GLenum colorFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+    MipFilter mipFilter = MIP_FILTER_KAISER;
+    unsigned int threadCount = thread::hardware_concurrency();
+    ImportProfile profile = IMPORT_PROFILE_RUNTIME;
+    bool force = false;
+    string manifestPath = "resources/cook.manifest";
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "--bc1")
+        {
+            colorFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        }
+        else if (argument == "--box")
+        {
+            mipFilter = MIP_FILTER_BOX;
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else if (argument == "--profile" && i + 1 < argc)
+        {
+            if (!ParseImportProfile(argv[++i], profile))
+            {
+                printUsage();
+                return 1;
+            }
+        }
+        else if (argument == "--force")
+        {
+            force = true;
+        }
+        else if (argument == "--manifest" && i + 1 < argc)
+        {
+            manifestPath = argv[++i];
+        }
+        else if (argument == "--help" || argument == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (argument.compare(0, 2, "--") == 0)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            paths.push_back(argument);
+        }
+    }
+    if (paths.empty())
+        paths.push_back("resources");
+
+    vector<string> models;
+    vector<CookJob> jobs;
+    unordered_set<string> seen;
+    for (const string& path : paths)
+    {
+        vector<string> files;
+        if (isModel(path))
+        {
+            models.push_back(path);
+        }
+        else if (hasExtension(path, ".mtl"))
+        {
+            collectMaterialTextures(path, jobs, seen);
+        }
+        else if (ListFiles(path, files))
+        {
+            for (const string& file : files)
+            {
+                if (isModel(file))
+                    models.push_back(file);
+                else if (hasExtension(file, ".mtl"))
+                    collectMaterialTextures(file, jobs, seen);
+            }
+        }
+        else
+        {
+            addJob(jobs, seen, path, USAGE_COLOR);
+        }
+    }
+    if (models.empty() && jobs.empty())
+    {
+        cout << "Nothing to cook" << endl;
+        return 1;
+    }
+
+    ThreadPool pool(threadCount);
+    Manifest manifest = readManifest(manifestPath);
+    int failures = 0;
+    CookTotals totals;
+
+    // models are independent and import on one thread each; log lines are buffered so they don't interleave
+    unsigned int importFlags = ImportFlagsFor(profile);
+    vector<ModelResult> modelResults(models.size());
+    mutex outputMutex;
+    auto modelsStart = chrono::steady_clock::now();
+    pool.ParallelFor(models.size(), [&](size_t i) {
+        ostringstream log;
+        modelResults[i] = cookModel(models[i], importFlags, manifest, force, log);
+        lock_guard<mutex> lock(outputMutex);
+        cout << log.str();
+    });
+    totals.importSeconds = chrono::duration<double>(chrono::steady_clock::now() - modelsStart).count();
+
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        ModelResult& result = modelResults[i];
+        if (result.failed)
+        {
+            failures++;
+            continue;
+        }
+        if (result.cooked)
+            totals.models++;
+        else
+            totals.skipped++;
+        manifest[MeshCache::CachePathFor(models[i])] = result.entry;
+        for (const CookJob& job : result.textures)
+            addJob(jobs, seen, job.path, job.usage);
+    }
+
+    // textures one at a time, each compressed on every thread
+    for (const CookJob& job : jobs)
+    {
+        GLenum format = textureFormat(job, colorFormat);
+        string output = ddsPathFor(job.path);
+        string settings = textureSettings(job, format, mipFilter);
+        if (!force && isUpToDate(manifest, output, settings))
+        {
+            totals.skipped++;
+            continue;
+        }
+        if (!cookTexture(job, colorFormat, mipFilter, pool, totals))
+        {
+            failures++;
+            continue;
+        }
+        ManifestEntry entry;
+        entry.inputs.push_back(job.path);
+        if (cookKey(settings, entry.inputs, entry.key))
+            manifest[output] = entry;
+    }
+
+    if (!writeManifest(manifestPath, manifest))
+    {
+        cout << "ERROR::COOKER:: Failed to write " << manifestPath << endl;
+        failures++;
+    }
+
+    if (totals.models > 0)
+    {
+        cout << "Imported " << totals.models << " models on " << pool.ThreadCount() << " threads in "
+            << fixed << setprecision(2) << totals.importSeconds << " s" << endl;
+    }
+    if (totals.textures > 0)
+    {
+        cout << "Cooked " << totals.textures << " textures on " << pool.ThreadCount() << " threads: "
+            << fixed << setprecision(2) << totals.sourceBytes / MEGABYTE << " MB -> " << totals.cookedBytes / MEGABYTE << " MB in "
+            << totals.encodeSeconds << " s (" << setprecision(1) << totals.sourceBytes / MEGABYTE / totals.encodeSeconds << " MB/s)" << endl;
+    }
+    if (totals.skipped > 0)
+        cout << "Skipped " << totals.skipped << " assets that are up to date" << endl;
+    return failures > 0 ? 1 : 0;
+}
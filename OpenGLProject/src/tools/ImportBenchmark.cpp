@@ -0,0 +1,212 @@
+// Headless import benchmark. Times every assimp post-processing step of each import profile on the given models,
+// as well as the whole import, and prints what the result contains so the cheapest profile that still gives the
+// shaders what they read can be picked.
+//
+// usage: ImportBenchmark [--profile NAME] [--runs N] path ...
+//   path       model file to import
+//   --profile  fast-preview, runtime or full-quality; all of them by default
+//   --runs     imports averaged per measurement, 3 by default
+//
+// Steps are applied one at a time with Importer::ApplyPostProcessing, in the order assimp runs them itself, after
+// reading the file without any. The total is a separate ReadFile with the profile's flags, as Model does it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <lib/ImportProfile.h>
+#include <lib/MappedIOSystem.h>
+
+using namespace std;
+
+namespace {
+
+    struct Step {
+        unsigned int flag;
+        const char* name;
+    };
+
+    // the steps the profiles use, in assimp's own pipeline order: the uv flip runs with the coordinate
+    // conversions, before normals and tangents are generated
+    const Step STEPS[] = {
+        { aiProcess_ValidateDataStructure, "ValidateDataStructure" },
+        { aiProcess_Triangulate, "Triangulate" },
+        { aiProcess_FindInvalidData, "FindInvalidData" },
+        { aiProcess_FlipUVs, "FlipUVs" },
+        { aiProcess_GenNormals, "GenNormals" },
+        { aiProcess_GenSmoothNormals, "GenSmoothNormals" },
+        { aiProcess_CalcTangentSpace, "CalcTangentSpace" },
+    };
+    const size_t STEP_COUNT = sizeof(STEPS) / sizeof(STEPS[0]);
+
+    // what an imported scene holds, to tell whether a profile's output is usable
+    struct SceneSummary {
+        size_t meshes = 0;
+        size_t vertices = 0;
+        size_t triangles = 0;
+        size_t otherFaces = 0;
+        size_t meshesWithNormals = 0;
+        size_t meshesWithTangents = 0;
+        size_t meshesWithTexCoords = 0;
+    };
+
+    double now() {
+        return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    SceneSummary summarize(const aiScene* scene) {
+        SceneSummary summary;
+        summary.meshes = scene->mNumMeshes;
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            const aiMesh* mesh = scene->mMeshes[i];
+            summary.vertices += mesh->mNumVertices;
+            for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+            {
+                if (mesh->mFaces[f].mNumIndices == 3)
+                    summary.triangles++;
+                else
+                    summary.otherFaces++;
+            }
+            summary.meshesWithNormals += mesh->HasNormals() ? 1 : 0;
+            summary.meshesWithTangents += mesh->HasTangentsAndBitangents() ? 1 : 0;
+            summary.meshesWithTexCoords += mesh->HasTextureCoords(0) ? 1 : 0;
+        }
+        return summary;
+    }
+
+    // averages runs imports of path with the profile, step by step and as a whole; false if assimp fails
+    bool benchmark(const string& path, ImportProfile profile, int runs) {
+        unsigned int flags = ImportFlagsFor(profile);
+        double readSeconds = 0.0, totalSeconds = 0.0;
+        vector<double> stepSeconds(STEP_COUNT, 0.0);
+        SceneSummary summary;
+
+        for (int run = 0; run < runs; run++)
+        {
+            Assimp::Importer importer;
+            importer.SetIOHandler(new MappedIOSystem());
+            double start = now();
+            const aiScene* scene = importer.ReadFile(path, 0);
+            readSeconds += now() - start;
+            if (!scene || !scene->mRootNode)
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return false;
+            }
+
+            for (size_t step = 0; step < STEP_COUNT; step++)
+            {
+                if (!(flags & STEPS[step].flag))
+                    continue;
+                start = now();
+                scene = importer.ApplyPostProcessing(STEPS[step].flag);
+                stepSeconds[step] += now() - start;
+                if (!scene)
+                {
+                    cout << "ERROR::ASSIMP:: " << STEPS[step].name << ": " << importer.GetErrorString() << endl;
+                    return false;
+                }
+            }
+            summary = summarize(scene);
+
+            Assimp::Importer wholeImporter;
+            wholeImporter.SetIOHandler(new MappedIOSystem());
+            start = now();
+            scene = wholeImporter.ReadFile(path, flags);
+            totalSeconds += now() - start;
+            if (!scene || !scene->mRootNode)
+            {
+                cout << "ERROR::ASSIMP:: " << wholeImporter.GetErrorString() << endl;
+                return false;
+            }
+        }
+
+        cout << path << ", " << ImportProfileName(profile) << ":" << endl << fixed << setprecision(2);
+        cout << "  " << left << setw(24) << "read" << right << setw(10) << readSeconds / runs * 1000.0 << " ms" << endl;
+        for (size_t step = 0; step < STEP_COUNT; step++)
+        {
+            if (flags & STEPS[step].flag)
+                cout << "  " << left << setw(24) << STEPS[step].name << right << setw(10) << stepSeconds[step] / runs * 1000.0 << " ms" << endl;
+        }
+        cout << "  " << left << setw(24) << "total import" << right << setw(10) << totalSeconds / runs * 1000.0 << " ms" << endl;
+        cout << "  " << summary.meshes << " meshes, " << summary.vertices << " vertices, " << summary.triangles << " triangles";
+        if (summary.otherFaces > 0)
+            cout << ", " << summary.otherFaces << " other faces";
+        cout << endl << "  normals in " << summary.meshesWithNormals << ", uvs in " << summary.meshesWithTexCoords
+            << ", tangents in " << summary.meshesWithTangents << " of " << summary.meshes << " meshes" << endl;
+        return true;
+    }
+
+    void printUsage() {
+        cout << "usage: ImportBenchmark [--profile NAME] [--runs N] path ..." << endl
+            << "  path       model file to import" << endl
+            << "  --profile  fast-preview, runtime or full-quality; all of them by default" << endl
+            << "  --runs     imports averaged per measurement, 3 by default" << endl;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    vector<ImportProfile> profiles;
+    int runs = 3;
+    vector<string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        ImportProfile profile;
+        if (argument == "--profile" && i + 1 < argc)
+        {
+            if (!ParseImportProfile(argv[++i], profile))
+            {
+                printUsage();
+                return 1;
+            }
+            profiles.push_back(profile);
+        }
+        else if (argument == "--runs" && i + 1 < argc)
+        {
+            runs = max(atoi(argv[++i]), 1);
+        }
+        else if (argument == "--help" || argument == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (argument.compare(0, 2, "--") == 0)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            paths.push_back(argument);
+        }
+    }
+    if (paths.empty())
+    {
+        printUsage();
+        return 1;
+    }
+    if (profiles.empty())
+    {
+        for (int profile = 0; profile < IMPORT_PROFILE_COUNT; profile++)
+            profiles.push_back((ImportProfile)profile);
+    }
+
+    int failures = 0;
+    for (const string& path : paths)
+        for (ImportProfile profile : profiles)
+            if (!benchmark(path, profile, runs))
+                failures++;
+    return failures > 0 ? 1 : 0;
+}